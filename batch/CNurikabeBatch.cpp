@@ -0,0 +1,444 @@
+#include <CNurikabe.h>
+#include <CNurikabeCorpus.h>
+#include <CNurikabeTrace.h>
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+// batch solver: loads board files (tokenised format) and solves them with a time limit
+class CNurikabeBatch : public CNurikabe {
+ public:
+  CNurikabeBatch() { }
+
+  // observe own solve for timeout (no observer needed without timeout)
+  void setTimeout(double secs) {
+    timer_.setTimeout(secs);
+
+    setObserver(secs > 0 ? &timer_ : nullptr);
+  }
+
+  bool isGrading() const { return grading_; }
+  void setGrading(bool b) { grading_ = b; }
+
+  // solve with default portfolio of strategies (instead of grading)
+  bool isPortfolio() const { return portfolio_; }
+  void setPortfolio(bool b) { portfolio_ = b; }
+
+  bool isShareCells() const { return shareCells_; }
+  void setShareCells(bool b) { shareCells_ = b; }
+
+  void startTimer() { timer_.start(); }
+
+  double elapsed() const { return timer_.elapsed(); }
+
+  bool isTimedOut() const { return timer_.isTimedOut(); }
+
+ private:
+  TimeoutObserver timer_;
+  bool            grading_    { false };
+  bool            portfolio_  { false };
+  bool            shareCells_ { true };
+};
+
+static void usage();
+static bool writeCorpus(CNurikabeBatch &nurikabe, const std::string &corpusFile,
+                        const std::vector<std::string> &files, bool builtin);
+static void solveFile(CNurikabeBatch &nurikabe, const std::string &filename, bool print);
+static void solveBuiltin(CNurikabeBatch &nurikabe, bool print);
+static void solveCorpus(CNurikabeBatch &nurikabe, const std::string &filename,
+                        int index, bool print);
+static bool replayTraces(CNurikabeBatch &nurikabe, const std::string &filename, bool print);
+static void solveScale(CNurikabeBatch &nurikabe, int minSize, int maxSize, int step);
+static void solveBoard(CNurikabeBatch &nurikabe, const std::string &name,
+                       double loadTime, bool print);
+
+int
+main(int argc, char **argv)
+{
+  CNurikabeBatch nurikabe;
+
+  double timeout     = 60.0;
+  bool   print       = false;
+  bool   builtin     = false;
+  bool   profile     = false;
+  bool   grade       = false;
+  bool   portfolio   = false;
+  bool   share       = true;
+  int    threads     = 1;
+  int    escalations = -1;
+  long   search      = 10000;
+
+  std::string corpusFile, writeFile, recordFile, replayFile;
+
+  int index = -1;
+
+  int minSize = 0, maxSize = 0, step = 0;
+
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-') {
+      std::string arg(&argv[i][1]);
+
+      if      (arg == "time" && i < argc - 1)
+        timeout = atof(argv[++i]);
+      else if (arg == "print")
+        print = true;
+      else if (arg == "builtin")
+        builtin = true;
+      else if (arg == "profile")
+        profile = true;
+      else if (arg == "grade")
+        grade = true;
+      else if (arg == "portfolio")
+        portfolio = true;
+      else if (arg == "no_share")
+        share = false;
+      else if (arg == "threads" && i < argc - 1)
+        threads = atoi(argv[++i]);
+      else if (arg == "escalations" && i < argc - 1)
+        escalations = atoi(argv[++i]);
+      else if (arg == "search" && i < argc - 1)
+        search = atol(argv[++i]);
+      else if (arg == "corpus" && i < argc - 1)
+        corpusFile = argv[++i];
+      else if (arg == "index" && i < argc - 1)
+        index = atoi(argv[++i]);
+      else if (arg == "write" && i < argc - 1)
+        writeFile = argv[++i];
+      else if (arg == "record" && i < argc - 1)
+        recordFile = argv[++i];
+      else if (arg == "replay" && i < argc - 1)
+        replayFile = argv[++i];
+      else if (arg == "scale" && i < argc - 3) {
+        minSize = atoi(argv[++i]);
+        maxSize = atoi(argv[++i]);
+        step    = atoi(argv[++i]);
+      }
+      else if (arg == "h" || arg == "help") {
+        usage();
+        exit(0);
+      }
+      else {
+        std::cerr << "Invalid option '" << argv[i] << "'" << std::endl;
+        usage();
+        exit(1);
+      }
+    }
+    else
+      files.push_back(argv[i]);
+  }
+
+  if (writeFile != "")
+    return (writeCorpus(nurikabe, writeFile, files, builtin) ? 0 : 1);
+
+  if (replayFile != "")
+    return (replayTraces(nurikabe, replayFile, print) ? 0 : 1);
+
+  nurikabe.setTimeout(timeout);
+  nurikabe.setProfiling(profile);
+  nurikabe.setGrading(grade);
+  nurikabe.setPortfolio(portfolio);
+  nurikabe.setShareCells(share);
+  nurikabe.setProbeThreads(threads);
+  nurikabe.setMaxEscalations(escalations);
+  nurikabe.setMaxSearchNodes(search);
+
+  // record deductions of all solved boards
+  std::ofstream recordStream;
+
+  CNurikabeTraceWriter traceWriter(recordStream);
+
+  if (recordFile != "") {
+    recordStream.open(recordFile, std::ios::binary);
+
+    if (! recordStream) {
+      std::cerr << "Failed to open '" << recordFile << "'" << std::endl;
+      return 1;
+    }
+
+    nurikabe.setTraceWriter(&traceWriter);
+  }
+
+  if (builtin)
+    solveBuiltin(nurikabe, print);
+
+  for (std::size_t i = 0; i < files.size(); ++i)
+    solveFile(nurikabe, files[i], print);
+
+  if (corpusFile != "")
+    solveCorpus(nurikabe, corpusFile, index, print);
+
+  if (step > 0)
+    solveScale(nurikabe, minSize, maxSize, step);
+
+  return 0;
+}
+
+static void
+usage()
+{
+  std::cerr << "CNurikabeBatch [-time <secs>] [-print] [-profile] [-grade] [-threads <n>] "
+               "[-escalations <n>] [-search <nodes>] [-portfolio [-no_share]] [-builtin] "
+               "[-corpus <file> [-index <i>]] [-scale <min> <max> <step>] "
+               "[-write <corpus_file>] [-record <trace_file>] [-replay <trace_file>] "
+               "<board_file> ..." << std::endl;
+}
+
+// pack built-in puzzles and board files into binary corpus
+static bool
+writeCorpus(CNurikabeBatch &nurikabe, const std::string &corpusFile,
+            const std::vector<std::string> &files, bool builtin)
+{
+  CNurikabeCorpusWriter writer;
+
+  if (! writer.open(corpusFile)) {
+    std::cerr << "Failed to open '" << corpusFile << "'" << std::endl;
+    return false;
+  }
+
+  if (builtin) {
+    for (int i = 1; i <= 9; ++i) {
+      nurikabe.setPuzzle(i);
+
+      writer.addPuzzle(nurikabe.getPuzzle());
+    }
+  }
+
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    if (! nurikabe.loadFile(files[i])) {
+      std::cerr << "Failed to load '" << files[i] << "'" << std::endl;
+      continue;
+    }
+
+    writer.addPuzzle(nurikabe.getPuzzle());
+  }
+
+  int n = writer.size();
+
+  if (! writer.close()) {
+    std::cerr << "Failed to write '" << corpusFile << "'" << std::endl;
+    return false;
+  }
+
+  std::cout << "Wrote " << n << " puzzles to " << corpusFile << std::endl;
+
+  return true;
+}
+
+static void
+solveBuiltin(CNurikabeBatch &nurikabe, bool print)
+{
+  for (int i = 1; i <= 9; ++i) {
+    nurikabe.startTimer();
+
+    nurikabe.setPuzzle(i);
+
+    double loadTime = nurikabe.elapsed();
+
+    std::stringstream name;
+
+    name << "puzzle" << i;
+
+    solveBoard(nurikabe, name.str(), loadTime, print);
+  }
+}
+
+// solve one or all puzzles of memory mapped corpus
+static void
+solveCorpus(CNurikabeBatch &nurikabe, const std::string &filename, int index, bool print)
+{
+  CNurikabeCorpus corpus;
+
+  if (! corpus.open(filename)) {
+    std::cerr << "Failed to open corpus '" << filename << "'" << std::endl;
+    return;
+  }
+
+  int i1 = 0, i2 = corpus.size() - 1;
+
+  if (index >= 0)
+    i1 = i2 = index;
+
+  CNurikabe::Puzzle puzzle;
+
+  for (int i = i1; i <= i2; ++i) {
+    nurikabe.startTimer();
+
+    if (! corpus.getPuzzle(i, puzzle) || ! nurikabe.init(puzzle)) {
+      std::cerr << "Failed to load puzzle " << i << " of '" << filename << "'" << std::endl;
+      continue;
+    }
+
+    double loadTime = nurikabe.elapsed();
+
+    std::stringstream name;
+
+    name << filename << "[" << i << "]";
+
+    solveBoard(nurikabe, name.str(), loadTime, print);
+  }
+}
+
+static void
+solveFile(CNurikabeBatch &nurikabe, const std::string &filename, bool print)
+{
+  nurikabe.startTimer();
+
+  if (! nurikabe.loadFile(filename)) {
+    std::cerr << "Failed to load '" << filename << "'" << std::endl;
+    return;
+  }
+
+  double loadTime = nurikabe.elapsed();
+
+  solveBoard(nurikabe, filename, loadTime, print);
+}
+
+// re-apply recorded deductions (no search) and report replay time
+static bool
+replayTraces(CNurikabeBatch &nurikabe, const std::string &filename, bool print)
+{
+  std::ifstream is(filename, std::ios::binary);
+
+  if (! is) {
+    std::cerr << "Failed to open '" << filename << "'" << std::endl;
+    return false;
+  }
+
+  CNurikabeTraceReader reader(is);
+
+  for (int i = 0; ; ++i) {
+    nurikabe.startTimer();
+
+    int numSteps = reader.replay(nurikabe);
+
+    double replayTime = nurikabe.elapsed();
+
+    if (numSteps < 0) {
+      if (! reader.isError())
+        break;
+
+      std::cerr << "Invalid trace " << i << " in '" << filename << "'" << std::endl;
+      return false;
+    }
+
+    std::cout << filename << "[" << i << "] " <<
+                 nurikabe.getNumRows() << "x" << nurikabe.getNumCols() <<
+                 " steps " << numSteps << std::fixed << std::setprecision(6) <<
+                 " replay " << replayTime << "s " <<
+                 (nurikabe.isSolved() ? "solved" : "partial") << std::endl;
+
+    if (print)
+      nurikabe.getGrid()->printMap(std::cout);
+  }
+
+  return true;
+}
+
+// generate boards of increasing size, round trip them through the streaming parser
+// and report load and solve times to show where the solver stops scaling
+static void
+solveScale(CNurikabeBatch &nurikabe, int minSize, int maxSize, int step)
+{
+  for (int size = minSize; size <= maxSize; size += step) {
+    nurikabe.generate(size, size);
+
+    std::stringstream ss;
+
+    nurikabe.save(ss);
+
+    nurikabe.startTimer();
+
+    if (! nurikabe.load(ss)) {
+      std::cerr << "Failed to load generated " << size << "x" << size << std::endl;
+      return;
+    }
+
+    double loadTime = nurikabe.elapsed();
+
+    std::stringstream name;
+
+    name << "generated_" << size << "x" << size;
+
+    solveBoard(nurikabe, name.str(), loadTime, false);
+  }
+}
+
+static void
+solveBoard(CNurikabeBatch &nurikabe, const std::string &name, double loadTime, bool print)
+{
+  nurikabe.resetStats();
+
+  CNurikabeTraceWriter *traceWriter = nurikabe.getTraceWriter();
+
+  if (traceWriter)
+    traceWriter->start(nurikabe.getPuzzle());
+
+  nurikabe.startTimer();
+
+  CNurikabe::Grade grade;
+
+  CNurikabe::Strategies strategies;
+
+  int strategy = -1;
+
+  if      (nurikabe.isPortfolio()) {
+    strategies = CNurikabe::defaultPortfolio();
+
+    strategy = nurikabe.solvePortfolio(strategies, nurikabe.isShareCells());
+  }
+  else if (nurikabe.isGrading())
+    nurikabe.grade(grade);
+  else
+    nurikabe.solve();
+
+  double solveTime = nurikabe.elapsed();
+
+  if (traceWriter)
+    traceWriter->end();
+
+  // count decided cells
+  int numCells = nurikabe.getNumRows()*nurikabe.getNumCols();
+  int numKnown = 0;
+
+  for (int r = 0; r < nurikabe.getNumRows(); ++r) {
+    for (int c = 0; c < nurikabe.getNumCols(); ++c) {
+      if (! nurikabe.getCell(CNurikabe::Coord(r, c))->isUnknown())
+        ++numKnown;
+    }
+  }
+
+  const char *status = "stalled";
+
+  if      (nurikabe.isSolved())
+    status = "solved";
+  else if (nurikabe.isTimedOut())
+    status = "timeout";
+
+  std::cout << name << " " << nurikabe.getNumRows() << "x" << nurikabe.getNumCols() <<
+               std::fixed << std::setprecision(6) <<
+               " load " << loadTime << "s solve " << solveTime << "s " <<
+               numKnown << "/" << numCells << " " << status;
+
+  if      (nurikabe.isPortfolio())
+    std::cout << " strategy " << (strategy >= 0 ? strategies[strategy].name : "none");
+  else if (nurikabe.isGrading())
+    std::cout << " tier " << grade.tier << " escalations " << grade.numEscalations <<
+                 " steps " << grade.numSteps[CNurikabe::TIER_SIMPLE] << "/" <<
+                 grade.numSteps[CNurikabe::TIER_PROBE] << "/" <<
+                 grade.numSteps[CNurikabe::TIER_RECURSE] << "/" <<
+                 grade.numSteps[CNurikabe::TIER_ESCALATED] << "/" <<
+                 grade.numSteps[CNurikabe::TIER_SEARCH] <<
+                 " work " << grade.work << std::setprecision(2) << " score " << grade.score;
+
+  std::cout << std::endl;
+
+  if (print)
+    nurikabe.getGrid()->printMap(std::cout);
+
+  if (nurikabe.isProfiling())
+    nurikabe.getStats().print(std::cout);
+}
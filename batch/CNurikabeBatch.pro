@@ -0,0 +1,42 @@
+TEMPLATE = app
+
+CONFIG += console thread
+CONFIG -= qt app_bundle
+
+TARGET = CNurikabeBatch
+
+DEPENDPATH += .
+
+QMAKE_CXXFLAGS += -std=c++17
+
+# solver trace (CNURIKABE_LOG) is compiled out of release builds
+CONFIG(release, debug|release): DEFINES += CNURIKABE_NO_TRACE
+
+#CONFIG += debug
+
+# Input
+SOURCES += \
+CNurikabeBatch.cpp \
+../src/CNurikabe.cpp \
+../src/CNurikabeCorpus.cpp \
+../src/CNurikabeTrace.cpp
+
+HEADERS += \
+../src/CNurikabe.h \
+../src/CNurikabeBitBoard.h \
+../src/CNurikabeBitKernels.h \
+../src/CNurikabeImplications.h \
+../src/CNurikabeLog.h \
+../src/CNurikabeNogoods.h \
+../src/CNurikabePatterns.h \
+../src/CNurikabeRand.h \
+../src/CNurikabeTrace.h \
+../src/CNurikabeWall.h \
+../src/CNurikabeCorpus.h
+
+DESTDIR     = ../bin
+OBJECTS_DIR = ../obj/batch
+
+INCLUDEPATH += \
+../src \
+.
@@ -0,0 +1,301 @@
+#include <CNurikabe.h>
+#include <CNurikabeCorpus.h>
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+
+// benchmark: solves each puzzle a fixed number of times and reports solve time
+// statistics and solver work counters (table on stdout, optional JSON file)
+class CNurikabeBench : public CNurikabe {
+ public:
+  CNurikabeBench() { }
+
+  // observe own solve for timeout (no observer needed without timeout)
+  void setTimeout(double secs) {
+    timer_.setTimeout(secs);
+
+    setObserver(secs > 0 ? &timer_ : nullptr);
+  }
+
+  void startTimer() { timer_.start(); }
+
+  double elapsed() const { return timer_.elapsed(); }
+
+  bool isTimedOut() const { return timer_.isTimedOut(); }
+
+ private:
+  TimeoutObserver timer_;
+};
+
+// results for one benchmarked puzzle
+struct BenchResult {
+  std::string         name;
+  int                 rows     { 0 };
+  int                 cols     { 0 };
+  bool                solved   { false };
+  int                 timeouts { 0 };
+  std::vector<double> times;
+  CNurikabe::Stats    stats;
+};
+
+typedef std::vector<BenchResult> BenchResults;
+
+static void usage();
+static bool benchPuzzle(CNurikabeBench &nurikabe, const std::string &name,
+                        const CNurikabe::Puzzle &puzzle, int runs, BenchResult &result);
+static double percentile(std::vector<double> times, double p);
+static void printResult(const BenchResult &result);
+static bool writeJson(const std::string &filename, const BenchResults &results,
+                      int runs, double timeout);
+
+int
+main(int argc, char **argv)
+{
+  CNurikabeBench nurikabe;
+
+  int    runs     = 5;
+  double timeout  = 30.0;
+  bool   builtin  = true;
+  bool   profile  = false;
+
+  std::string jsonFile;
+
+  std::vector<std::string> corpusFiles, files;
+
+  for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-') {
+      std::string arg(&argv[i][1]);
+
+      if      (arg == "runs" && i < argc - 1)
+        runs = std::max(atoi(argv[++i]), 1);
+      else if (arg == "time" && i < argc - 1)
+        timeout = atof(argv[++i]);
+      else if (arg == "json" && i < argc - 1)
+        jsonFile = argv[++i];
+      else if (arg == "corpus" && i < argc - 1)
+        corpusFiles.push_back(argv[++i]);
+      else if (arg == "no_builtin")
+        builtin = false;
+      else if (arg == "profile")
+        profile = true;
+      else if (arg == "h" || arg == "help") {
+        usage();
+        exit(0);
+      }
+      else {
+        std::cerr << "Invalid option '" << argv[i] << "'" << std::endl;
+        usage();
+        exit(1);
+      }
+    }
+    else
+      files.push_back(argv[i]);
+  }
+
+  nurikabe.setTimeout(timeout);
+  nurikabe.setProfiling(profile);
+
+  BenchResults results;
+
+  auto addResult = [&](const std::string &name, const CNurikabe::Puzzle &puzzle) {
+    BenchResult result;
+
+    if (! benchPuzzle(nurikabe, name, puzzle, runs, result)) {
+      std::cerr << "Failed to load '" << name << "'" << std::endl;
+      return;
+    }
+
+    printResult(result);
+
+    results.push_back(result);
+  };
+
+  if (builtin) {
+    for (int i = 1; i <= 9; ++i) {
+      nurikabe.setPuzzle(i);
+
+      std::stringstream name;
+
+      name << "puzzle" << i;
+
+      addResult(name.str(), nurikabe.getPuzzle());
+    }
+  }
+
+  for (std::size_t i = 0; i < files.size(); ++i) {
+    if (! nurikabe.loadFile(files[i])) {
+      std::cerr << "Failed to load '" << files[i] << "'" << std::endl;
+      continue;
+    }
+
+    addResult(files[i], nurikabe.getPuzzle());
+  }
+
+  for (std::size_t i = 0; i < corpusFiles.size(); ++i) {
+    CNurikabeCorpus corpus;
+
+    if (! corpus.open(corpusFiles[i])) {
+      std::cerr << "Failed to open corpus '" << corpusFiles[i] << "'" << std::endl;
+      continue;
+    }
+
+    CNurikabe::Puzzle puzzle;
+
+    for (int j = 0; j < corpus.size(); ++j) {
+      std::stringstream name;
+
+      name << corpusFiles[i] << "[" << j << "]";
+
+      if (! corpus.getPuzzle(j, puzzle)) {
+        std::cerr << "Failed to load '" << name.str() << "'" << std::endl;
+        continue;
+      }
+
+      addResult(name.str(), puzzle);
+    }
+  }
+
+  if (jsonFile != "" && ! writeJson(jsonFile, results, runs, timeout)) {
+    std::cerr << "Failed to write '" << jsonFile << "'" << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+static void
+usage()
+{
+  std::cerr << "CNurikabeBench [-runs <n>] [-time <secs>] [-json <file>] [-profile] "
+               "[-no_builtin] [-corpus <file>] ... <board_file> ..." << std::endl;
+}
+
+// solve puzzle from scratch 'runs' times, timing only the solve
+static bool
+benchPuzzle(CNurikabeBench &nurikabe, const std::string &name,
+            const CNurikabe::Puzzle &puzzle, int runs, BenchResult &result)
+{
+  result.name = name;
+  result.rows = puzzle.rows;
+  result.cols = puzzle.cols;
+
+  for (int i = 0; i < runs; ++i) {
+    if (! nurikabe.init(puzzle))
+      return false;
+
+    nurikabe.resetStats();
+
+    nurikabe.startTimer();
+
+    nurikabe.solve();
+
+    result.times.push_back(nurikabe.elapsed());
+
+    if (nurikabe.isTimedOut())
+      ++result.timeouts;
+
+    // solver is deterministic so counters of first run are representative
+    if (i == 0) {
+      result.solved = nurikabe.isSolved();
+      result.stats  = nurikabe.getStats();
+    }
+  }
+
+  return true;
+}
+
+// nearest rank percentile
+static double
+percentile(std::vector<double> times, double p)
+{
+  if (times.empty())
+    return 0.0;
+
+  std::sort(times.begin(), times.end());
+
+  int n = int(times.size());
+  int i = std::min(std::max(int(p*n + 0.999999) - 1, 0), n - 1);
+
+  return times[i];
+}
+
+static void
+printResult(const BenchResult &result)
+{
+  std::cout << std::left << std::setw(20) << result.name << std::right <<
+               " " << result.rows << "x" << result.cols <<
+               std::fixed << std::setprecision(6) <<
+               " median " << percentile(result.times, 0.5) << "s" <<
+               " p95 " << percentile(result.times, 0.95) << "s" <<
+               " rebuilds " << result.stats.numRebuilds <<
+               " checkValid " << result.stats.numCheckValid <<
+               " solutions " << result.stats.numSolutions <<
+               " " << (result.solved ? "solved" : "unsolved");
+
+  if (result.timeouts > 0)
+    std::cout << " timeouts " << result.timeouts;
+
+  std::cout << std::endl;
+}
+
+static std::string
+jsonString(const std::string &str)
+{
+  std::string str1 = "\"";
+
+  for (std::size_t i = 0; i < str.size(); ++i) {
+    if (str[i] == '"' || str[i] == '\\')
+      str1 += '\\';
+
+    str1 += str[i];
+  }
+
+  return str1 + "\"";
+}
+
+static bool
+writeJson(const std::string &filename, const BenchResults &results, int runs, double timeout)
+{
+  std::ofstream os(filename);
+
+  if (! os)
+    return false;
+
+  os << "{\n";
+  os << "  \"runs\": " << runs << ",\n";
+  os << "  \"timeout\": " << timeout << ",\n";
+  os << "  \"puzzles\": [\n";
+
+  os << std::fixed << std::setprecision(6);
+
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const BenchResult &result = results[i];
+
+    os << "    { \"name\": " << jsonString(result.name) <<
+          ", \"rows\": " << result.rows << ", \"cols\": " << result.cols <<
+          ", \"solved\": " << (result.solved ? "true" : "false") <<
+          ", \"timeouts\": " << result.timeouts <<
+          ", \"median\": " << percentile(result.times, 0.5) <<
+          ", \"p95\": " << percentile(result.times, 0.95) <<
+          ", \"rebuilds\": " << result.stats.numRebuilds <<
+          ", \"checkValid\": " << result.stats.numCheckValid <<
+          ", \"solutions\": " << result.stats.numSolutions;
+
+    if (! result.stats.rules.empty()) {
+      os << ", \"profile\": ";
+
+      result.stats.printJson(os);
+    }
+
+    os << " }" <<
+          (i + 1 < results.size() ? "," : "") << "\n";
+  }
+
+  os << "  ]\n";
+  os << "}\n";
+
+  return bool(os);
+}
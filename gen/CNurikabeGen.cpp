@@ -1,70 +1,980 @@
 #include <CNurikabeGen.h>
+#include <CNurikabeCorpus.h>
+#include <CNurikabeTrace.h>
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <cstring>
+
+// state shared by generator threads
+struct GenState {
+  std::mutex              mutex;
+  int                     count    { 0 };
+  int                     target   { 0 };
+  bool                    print    { false };
+  CNurikabeCorpusWriter  *writer   { nullptr };
+  CNurikabeGen::Stats     stats;
+};
+
+static void usage();
+static bool readMask(const std::string &filename, CNurikabeGen::Options &options);
+static void genThread(const CNurikabeGen::Options &options, uint64_t seed, GenState *state);
+
+int
+main(int argc, char **argv)
+{
+  CNurikabeGen::Options options;
+
+  int          count      = 10;
+  int          numThreads = std::max(int(std::thread::hardware_concurrency()), 1);
+  uint64_t     seed       = uint64_t(time(nullptr));
+  uint64_t     puzzleSeed = 0;
+  bool         print      = false;
+
+  std::string corpusFile, maskFile;
+
+  for (int i = 1; i < argc; ++i) {
+    if (argv[i][0] == '-') {
+      std::string arg(&argv[i][1]);
+
+      if      (arg == "size" && i < argc - 1)
+        options.rows = options.cols = atoi(argv[++i]);
+      else if (arg == "rows" && i < argc - 1)
+        options.rows = atoi(argv[++i]);
+      else if (arg == "cols" && i < argc - 1)
+        options.cols = atoi(argv[++i]);
+      else if (arg == "count" && i < argc - 1)
+        count = atoi(argv[++i]);
+      else if (arg == "threads" && i < argc - 1)
+        numThreads = std::max(atoi(argv[++i]), 1);
+      else if (arg == "seed" && i < argc - 1)
+        seed = strtoull(argv[++i], nullptr, 10);
+      else if (arg == "puzzle_seed" && i < argc - 1)
+        puzzleSeed = strtoull(argv[++i], nullptr, 10);
+      else if (arg == "black" && i < argc - 1)
+        options.blackFraction = atof(argv[++i]);
+      else if (arg == "max_island" && i < argc - 1)
+        options.maxIsland = atoi(argv[++i]);
+      else if (arg == "givens" && i < argc - 1)
+        options.maxGivens = atoi(argv[++i]);
+      else if (arg == "minimise")
+        options.minimise = true;
+      else if (arg == "compare_minimise")
+        options.minimise = options.compareMinimise = true;
+      else if (arg == "time" && i < argc - 1)
+        options.timeout = atof(argv[++i]);
+      else if (arg == "escalations" && i < argc - 1)
+        options.escalations = atoi(argv[++i]);
+      else if (arg == "symmetry" && i < argc - 1) {
+        std::string name(argv[++i]);
+
+        if      (name == "none"  ) options.symmetry = CNurikabeGen::SYMMETRY_NONE;
+        else if (name == "rot180") options.symmetry = CNurikabeGen::SYMMETRY_ROT180;
+        else if (name == "rot90" ) options.symmetry = CNurikabeGen::SYMMETRY_ROT90;
+        else if (name == "mirror") options.symmetry = CNurikabeGen::SYMMETRY_MIRROR;
+        else {
+          std::cerr << "Invalid symmetry '" << name << "'" << std::endl;
+          exit(1);
+        }
+      }
+      else if (arg == "mask" && i < argc - 1)
+        maskFile = argv[++i];
+      else if (arg == "corpus" && i < argc - 1)
+        corpusFile = argv[++i];
+      else if (arg == "print")
+        print = true;
+      else if (arg == "h" || arg == "help") {
+        usage();
+        exit(0);
+      }
+      else {
+        std::cerr << "Invalid option '" << argv[i] << "'" << std::endl;
+        usage();
+        exit(1);
+      }
+    }
+    else {
+      std::cerr << "Invalid arg '" << argv[i] << "'" << std::endl;
+      usage();
+      exit(1);
+    }
+  }
+
+  // mask sets board size
+  if (maskFile != "" && ! readMask(maskFile, options)) {
+    std::cerr << "Failed to read mask '" << maskFile << "'" << std::endl;
+    exit(1);
+  }
+
+  if (options.rows < 2 || options.cols < 2) {
+    std::cerr << "Invalid size " << options.rows << "x" << options.cols << std::endl;
+    exit(1);
+  }
+
+  // a white area crossing the mirror line/centre maps to itself and needs its clue on a
+  // fixed cell, which only exists for an odd number of columns (mirror) or an odd
+  // square board (rot90)
+  if (options.symmetry == CNurikabeGen::SYMMETRY_ROT90 &&
+      (options.rows != options.cols || options.rows % 2 == 0)) {
+    std::cerr << "rot90 symmetry needs an odd size square board" << std::endl;
+    exit(1);
+  }
+
+  if (options.symmetry == CNurikabeGen::SYMMETRY_MIRROR && options.cols % 2 == 0) {
+    std::cerr << "mirror symmetry needs an odd number of columns" << std::endl;
+    exit(1);
+  }
+
+  // reproduce single candidate from seed reported by '# seed' (same size/options)
+  if (puzzleSeed) {
+    CNurikabeGen gen(options);
+
+    CNurikabe::Puzzle puzzle;
+
+    if (! gen.generate(puzzle, puzzleSeed)) {
+      std::cerr << "Seed " << puzzleSeed << " does not give a unique puzzle" << std::endl;
+      exit(1);
+    }
+
+    CNurikabe printer;
+
+    printer.init(puzzle);
+
+    std::cout << "# seed " << puzzle.seed << "\n";
+
+    printer.save(std::cout);
+
+    return 0;
+  }
+
+  CNurikabeCorpusWriter writer;
+
+  if (corpusFile != "" && ! writer.open(corpusFile)) {
+    std::cerr << "Failed to open '" << corpusFile << "'" << std::endl;
+    exit(1);
+  }
+
+  GenState state;
+
+  state.target = count;
+  state.print  = print;
+  state.writer = (corpusFile != "" ? &writer : nullptr);
+
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < numThreads; ++i)
+    threads.push_back(std::thread(genThread, options, seed + i, &state));
+
+  for (std::size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+
+  double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (state.writer && ! writer.close()) {
+    std::cerr << "Failed to write '" << corpusFile << "'" << std::endl;
+    exit(1);
+  }
+
+  std::cerr << state.count << " unique " << options.rows << "x" << options.cols <<
+               " puzzles from " << state.stats.numCandidates << " candidates (" <<
+               state.stats.numRejected << " rejected, " << state.stats.numUnsolved <<
+               " not unique) in " << secs << "s, " << numThreads << " threads, " <<
+               int(state.count*60.0/std::max(secs, 1e-6)) << " per minute" << std::endl;
+
+  const CNurikabeGen::Stats &stats = state.stats;
+
+  if (options.minimise && stats.numMinimiseTrials > 0) {
+    std::cerr << "minimise " << stats.numMinimiseTrials << " trials in " <<
+                 stats.minimiseTime << "s";
+
+    if (options.compareMinimise)
+      std::cerr << " (naive " << stats.naiveMinimiseTime << "s, saved " <<
+                   stats.naiveMinimiseTime - stats.minimiseTime << "s, " <<
+                   stats.numMinimiseMismatch << " different results)";
+
+    std::cerr << std::endl;
+  }
+
+  return 0;
+}
+
+static void
+usage()
+{
+  std::cerr << "CNurikabeGen [-size <n>] [-rows <n>] [-cols <n>] [-count <n>] "
+               "[-threads <n>] [-seed <n>] [-puzzle_seed <n>] [-black <fraction>] "
+               "[-max_island <n>] "
+               "[-givens <n>] [-minimise] [-compare_minimise] [-time <secs>] [-escalations <n>] "
+               "[-symmetry none|rot180|rot90|mirror] [-mask <file>] "
+               "[-corpus <file>] [-print]" <<
+               std::endl;
+}
+
+// read clue mask: one line per row, 'x' for a clue cell and '.' for any other cell
+// (spaces ignored). Each white area of a generated board has a clue on exactly one
+// mask cell, so every mask cell is a clue
+static bool
+readMask(const std::string &filename, CNurikabeGen::Options &options)
+{
+  std::ifstream is(filename.c_str());
+
+  if (! is)
+    return false;
+
+  std::vector<char> mask;
+
+  int rows = 0, cols = 0;
+
+  std::string line;
+
+  while (std::getline(is, line)) {
+    std::vector<char> row;
+
+    for (std::size_t i = 0; i < line.size(); ++i) {
+      char c = line[i];
+
+      if      (c == 'x' || c == 'X') row.push_back(1);
+      else if (c == '.'            ) row.push_back(0);
+      else if (! isspace(c))
+        return false;
+    }
+
+    if (row.empty()) continue;
+
+    if (rows > 0 && int(row.size()) != cols)
+      return false;
+
+    cols = row.size();
+
+    ++rows;
+
+    mask.insert(mask.end(), row.begin(), row.end());
+  }
+
+  if (rows == 0)
+    return false;
+
+  options.rows     = rows;
+  options.cols     = cols;
+  options.clueMask = mask;
+
+  return true;
+}
+
+// generate puzzles until shared target count is reached
+static void
+genThread(const CNurikabeGen::Options &options, uint64_t seed, GenState *state)
+{
+  CNurikabeGen gen(options);
+
+  gen.setSeed(seed);
+
+  CNurikabe printer;
+
+  CNurikabe::Puzzle puzzle;
+
+  CNurikabeGen::Stats lastStats;
+
+  for (;;) {
+    {
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    if (state->count >= state->target)
+      break;
+    }
+
+    bool rc = gen.generate(puzzle);
+
+    std::lock_guard<std::mutex> lock(state->mutex);
+
+    // accumulate stats delta
+    const CNurikabeGen::Stats &stats = gen.getStats();
+
+    state->stats.numCandidates += stats.numCandidates - lastStats.numCandidates;
+    state->stats.numRejected   += stats.numRejected   - lastStats.numRejected;
+    state->stats.numUnsolved   += stats.numUnsolved   - lastStats.numUnsolved;
+    state->stats.numUnique     += stats.numUnique     - lastStats.numUnique;
+
+    state->stats.numMinimiseTrials   += stats.numMinimiseTrials - lastStats.numMinimiseTrials;
+    state->stats.minimiseTime        += stats.minimiseTime      - lastStats.minimiseTime;
+    state->stats.naiveMinimiseTime   += stats.naiveMinimiseTime - lastStats.naiveMinimiseTime;
+    state->stats.numMinimiseMismatch +=
+      stats.numMinimiseMismatch - lastStats.numMinimiseMismatch;
+
+    lastStats = stats;
+
+    if (! rc || state->count >= state->target)
+      continue;
+
+    ++state->count;
+
+    if (state->writer)
+      state->writer->addPuzzle(puzzle);
+
+    if (state->print) {
+      printer.init(puzzle);
+
+      std::cout << "# puzzle " << state->count << "\n";
+      std::cout << "# seed " << puzzle.seed << "\n";
+
+      printer.save(std::cout);
+
+      std::cout << std::endl;
+    }
+  }
+}
+
+//-------------
+
+CNurikabeGen::
+CNurikabeGen(const Options &options) :
+ options_(options), rows_(options.rows), cols_(options.cols)
+{
+  cells_.resize(rows_*cols_);
+
+  wall_.resize(rows_, cols_);
+
+  solver_.setTimeout(options_.timeout);
+
+  // give up early on boards needing expensive enumeration
+  solver_.setMaxEscalations(options_.escalations);
+
+  // puzzles must be solvable by deduction, not cell search, and probing costs more
+  // than it gains on candidate boards (most of which aren't unique)
+  solver_.setMaxSearchNodes(0);
+  solver_.setProbing       (false);
+
+  // with no givens to add and no escalations most candidates aren't unique, so reject
+  // at the first stall of the simple rules instead of running enumeration
+  if (options_.maxGivens == 0 && options_.escalations == 0)
+    solver_.setEnumerating(false);
+}
+
+bool
+CNurikabeGen::
+generate(CNurikabe::Puzzle &puzzle)
+{
+  // zero is reserved for 'not generated'
+  uint64_t seed = seeds_.next();
+
+  if (seed == 0)
+    seed = 1;
+
+  return generate(puzzle, seed);
+}
+
+bool
+CNurikabeGen::
+generate(CNurikabe::Puzzle &puzzle, uint64_t seed)
+{
+  rand_.seed(seed);
+
+  ++stats_.numCandidates;
+
+  if (! generateSolution(puzzle)) {
+    ++stats_.numRejected;
+    return false;
+  }
+
+  if (! makeUnique(puzzle)) {
+    ++stats_.numUnsolved;
+    return false;
+  }
+
+  ++stats_.numUnique;
+
+  return true;
+}
+
+// build random solved board and puzzle (numbers only) for it
+bool
+CNurikabeGen::
+generateSolution(CNurikabe::Puzzle &puzzle)
+{
+  growWall();
+
+  // symmetric growth can leave separate walls which never joined
+  if (! splitAreas() || ! wall_.isConnected())
+    return false;
+
+  if (! addClues())
+    return false;
+
+  int numCells = rows_*cols_;
+
+  puzzle.rows = rows_;
+  puzzle.cols = cols_;
+
+  puzzle.seed = rand_.getSeed();
+
+  puzzle.values  .resize(numCells);
+  puzzle.solution.resize(numCells);
+
+  for (int i = 0; i < numCells; ++i) {
+    int value = cells_[i].value;
+
+    puzzle.values  [i] = (value > 0 ? value : int(CNurikabe::Cell::UNKNOWN));
+    puzzle.solution[i] = value;
+  }
+
+  return true;
+}
+
+// grow black wall from random edge cell until black fraction is reached or no cell
+// can be added. A cell which would complete a 2x2 block can never be added later
+// (blacks are never removed) so it is dropped from the frontier. Cells are added with
+// their symmetry images so the wall stays symmetric
 void
 CNurikabeGen::
-generate(int rows, int cols)
+growWall()
 {
-  rows_ = rows;
-  cols_ = cols;
+  int numCells = rows_*cols_;
 
-  cells_.resize(rows_*cols_);
+  for (int i = 0; i < numCells; ++i)
+    cells_[i].setUnknown();
+
+  wall_.reset();
+
+  int targetBlack = std::max(int(options_.blackFraction*numCells), 1);
+
+  Inds frontier, orbit;
+
+  for (int i = 0; i < numCells; ++i) {
+    getOrbit(randEdge(), orbit);
+
+    if (canAddOrbit(orbit))
+      break;
+  }
+
+  if (! canAddOrbit(orbit))
+    return;
+
+  addOrbit(orbit, frontier);
+
+  while (wall_.numBlack() < targetBlack && ! frontier.empty()) {
+    int i = randInt(frontier.size());
+
+    int ind = frontier[i];
 
-  Cell *startCell = randEdge();
+    frontier[i] = frontier.back();
 
-  startCell->setBlack();
+    frontier.pop_back();
 
-  blackCells.push_back(startCell);
+    if (! getCell(ind).isUnknown())
+      continue;
 
-  while (true) {
-    int n = blackCells.size();
+    getOrbit(ind, orbit);
 
-    Cell *cell = blackCells[rand(n)];
+    if (! canAddOrbit(orbit))
+      continue;
 
-    Cell *cellN = cell->getN();
-    Cell *cellS = cell->getS();
-    Cell *cellE = cell->getE();
-    Cell *cellW = cell->getW();
+    addOrbit(orbit, frontier);
+  }
+}
+
+// extend wall into white areas larger than max island size, or holding more than
+// one clue mask cell (false if an area can't be split)
+bool
+CNurikabeGen::
+splitAreas()
+{
+  int numCells = rows_*cols_;
+
+  Inds orbit;
+
+  for (;;) {
+    getAreas();
+
+    std::vector<int> numMask(areas_.size(), 0);
+
+    if (! options_.clueMask.empty()) {
+      for (int i = 0; i < numCells; ++i)
+        if (options_.clueMask[i] && cells_[i].isUnknown())
+          ++numMask[area_[i]];
+    }
+
+    Inds frontier;
 
-    Cells openCells;
+    bool oversize = false;
 
-    if (cellN && ! cellN->isBlack()) openCells.insert(cellN);
-    if (cellS && ! cellS->isBlack()) openCells.insert(cellS);
-    if (cellE && ! cellE->isBlack()) openCells.insert(cellE);
-    if (cellW && ! cellW->isBlack()) openCells.insert(cellW);
+    for (int i = 0; i < numCells; ++i) {
+      if (! cells_[i].isUnknown())
+        continue;
 
-    bool found = false;
+      if (int(areas_[area_[i]].size()) <= options_.maxIsland && numMask[area_[i]] <= 1)
+        continue;
 
-    while (true) {
-      int n = openCells.size();
+      oversize = true;
 
-      if (n == 0) break;
+      if (wall_.touchesBlack(i))
+        frontier.push_back(i);
+    }
+
+    if (! oversize)
+      return true;
+
+    // add one black cell to each oversize area
+    std::vector<bool> split(areas_.size(), false);
+
+    bool added = false;
+
+    while (! frontier.empty()) {
+      int i = randInt(frontier.size());
+
+      int ind = frontier[i];
 
-      int i = rand(n);
+      frontier[i] = frontier.back();
 
-      Cell *cell = openCells[i];
+      frontier.pop_back();
 
-      openCells.erase(cell);
+      if (split[area_[ind]] || ! cells_[ind].isUnknown()) continue;
 
-      cell->setBlack();
+      getOrbit(ind, orbit);
 
-      bool rc = verify();
+      if (! canAddOrbit(orbit)) continue;
 
-      if (rc) {
-        found = true;
-        break;
+      for (std::size_t j = 0; j < orbit.size(); ++j) {
+        split[area_[orbit[j]]] = true;
+
+        addBlack(orbit[j]);
       }
 
-      cell->setUnknown();
+      added = true;
     }
 
-    if (! found)
+    if (! added)
+      return false;
+  }
+}
+
+// label connected white (non black) areas
+void
+CNurikabeGen::
+getAreas()
+{
+  int numCells = rows_*cols_;
+
+  area_.assign(numCells, -1);
+
+  areas_.clear();
+
+  Inds stack;
+
+  for (int i = 0; i < numCells; ++i) {
+    if (cells_[i].isBlack() || area_[i] >= 0) continue;
+
+    int id = areas_.size();
+
+    areas_.push_back(Inds());
+
+    Inds &area = areas_.back();
+
+    stack.push_back(i);
+
+    area_[i] = id;
+
+    while (! stack.empty()) {
+      int ind = stack.back();
+
+      stack.pop_back();
+
+      area.push_back(ind);
+
+      int r = ind / cols_, c = ind % cols_;
+
+      int neighbours[4] = {
+        (r > 0         ? ind - cols_ : -1), (r < rows_ - 1 ? ind + cols_ : -1),
+        (c > 0         ? ind - 1     : -1), (c < cols_ - 1 ? ind + 1     : -1) };
+
+      for (int j = 0; j < 4; ++j) {
+        int ind1 = neighbours[j];
+
+        if (ind1 >= 0 && ! cells_[ind1].isBlack() && area_[ind1] < 0) {
+          area_[ind1] = id;
+
+          stack.push_back(ind1);
+        }
+      }
+    }
+  }
+}
+
+// number each white area at a random cell. The clue cell's images number the image
+// areas, so an area which maps to itself needs its clue on a cell fixed by that map.
+// Only clue mask cells are numbered (false if an area has no valid clue cell)
+bool
+CNurikabeGen::
+addClues()
+{
+  getAreas();
+
+  std::vector<bool> numbered(areas_.size(), false);
+
+  Inds candidates, orbit;
+
+  for (std::size_t i = 0; i < areas_.size(); ++i) {
+    if (numbered[i]) continue;
+
+    const Inds &area = areas_[i];
+
+    candidates.clear();
+
+    for (std::size_t j = 0; j < area.size(); ++j) {
+      getOrbit(area[j], orbit);
+
+      bool valid = true;
+
+      for (std::size_t k = 0; valid && k < orbit.size(); ++k) {
+        if (! options_.clueMask.empty() && ! options_.clueMask[orbit[k]])
+          valid = false;
+
+        if (k > 0 && area_[orbit[k]] == int(i))
+          valid = false;
+      }
+
+      if (valid)
+        candidates.push_back(area[j]);
+    }
+
+    if (candidates.empty())
+      return false;
+
+    getOrbit(candidates[randInt(candidates.size())], orbit);
+
+    for (std::size_t k = 0; k < orbit.size(); ++k) {
+      const Inds &area1 = areas_[area_[orbit[k]]];
+
+      for (std::size_t j = 0; j < area1.size(); ++j)
+        cells_[area1[j]].value = CNurikabe::Cell::WHITE;
+
+      cells_[orbit[k]].value = area1.size();
+
+      numbered[area_[orbit[k]]] = true;
+    }
+  }
+
+  return true;
+}
+
+// cell and its distinct images under the symmetry (cell first)
+void
+CNurikabeGen::
+getOrbit(int ind, Inds &inds) const
+{
+  inds.clear();
+
+  inds.push_back(ind);
+
+  int r = ind / cols_, c = ind % cols_;
+
+  auto addImage = [&](int r1, int c1) {
+    int ind1 = r1*cols_ + c1;
+
+    if (std::find(inds.begin(), inds.end(), ind1) == inds.end())
+      inds.push_back(ind1);
+  };
+
+  switch (options_.symmetry) {
+    case SYMMETRY_ROT180:
+      addImage(rows_ - 1 - r, cols_ - 1 - c);
+      break;
+    case SYMMETRY_ROT90: // square board
+      addImage(c, rows_ - 1 - r);
+      addImage(rows_ - 1 - r, cols_ - 1 - c);
+      addImage(cols_ - 1 - c, r);
+      break;
+    case SYMMETRY_MIRROR:
+      addImage(r, cols_ - 1 - c);
+      break;
+    default:
+      break;
+  }
+}
+
+// check cells can all be made black (not clue mask cells and no 2x2 block)
+bool
+CNurikabeGen::
+canAddOrbit(const Inds &inds) const
+{
+  for (std::size_t i = 0; i < inds.size(); ++i) {
+    if (! cells_[inds[i]].isUnknown())
+      return false;
+
+    if (! options_.clueMask.empty() && options_.clueMask[inds[i]])
+      return false;
+  }
+
+  if (inds.size() == 1)
+    return wall_.canAdd(inds[0]);
+
+  return wall_.canAdd(inds);
+}
+
+// make cells black and add their unknown neighbours to frontier
+void
+CNurikabeGen::
+addOrbit(const Inds &inds, Inds &frontier)
+{
+  for (std::size_t i = 0; i < inds.size(); ++i)
+    addBlack(inds[i]);
+
+  for (std::size_t i = 0; i < inds.size(); ++i)
+    addNeighbours(inds[i], frontier);
+}
+
+// random cell on board edge
+int
+CNurikabeGen::
+randEdge()
+{
+  int perimeter = 2*(rows_ + cols_) - 4;
+
+  int i = randInt(perimeter);
+
+  if (i < cols_) return i;                                    // top
+  i -= cols_;
+  if (i < cols_) return (rows_ - 1)*cols_ + i;                // bottom
+  i -= cols_;
+  if (i < rows_ - 2) return (i + 1)*cols_;                    // left
+  i -= rows_ - 2;
+  return (i + 1)*cols_ + cols_ - 1;                           // right
+}
+
+// make cell black (caller checks wall_.canAdd so no 2x2 black block is made)
+void
+CNurikabeGen::
+addBlack(int ind)
+{
+  getCell(ind).setBlack();
+
+  wall_.add(ind);
+}
+
+void
+CNurikabeGen::
+addNeighbours(int ind, Inds &inds) const
+{
+  int r = ind / cols_, c = ind % cols_;
+
+  if (r > 0         && cells_[ind - cols_].isUnknown()) inds.push_back(ind - cols_);
+  if (r < rows_ - 1 && cells_[ind + cols_].isUnknown()) inds.push_back(ind + cols_);
+  if (c > 0         && cells_[ind - 1    ].isUnknown()) inds.push_back(ind - 1);
+  if (c < cols_ - 1 && cells_[ind + 1    ].isUnknown()) inds.push_back(ind + 1);
+}
+
+// check puzzle has unique solution by solving it without search, if solver stalls
+// add black/white givens from the solution until it completes
+bool
+CNurikabeGen::
+makeUnique(CNurikabe::Puzzle &puzzle)
+{
+  // record deductions from numbers only so minimisation can start from them
+  bool record = (options_.minimise && options_.maxGivens > 0);
+
+  if (solve(puzzle, record))
+    return true;
+
+  if (solver_.isTimedOut())
+    return false;
+
+  Inds givens;
+
+  while (int(givens.size()) < options_.maxGivens) {
+    Inds unknown;
+
+    for (int i = 0; i < rows_*cols_; ++i) {
+      if (solver_.getCell(CNurikabe::Coord(i / cols_, i % cols_))->isUnknown())
+        unknown.push_back(i);
+    }
+
+    if (unknown.empty())
+      return false;
+
+    int ind = unknown[randInt(unknown.size())];
+
+    puzzle.values[ind] = puzzle.solution[ind];
+
+    givens.push_back(ind);
+
+    // continue from stalled state (deductions made so far still hold)
+    CNurikabe::Cell *cell = solver_.getCell(CNurikabe::Coord(ind / cols_, ind % cols_));
+
+    solver_.startTimer();
+
+    if (puzzle.solution[ind] == CNurikabe::Cell::BLACK)
+      solver_.setCellBlack(cell);
+    else
+      solver_.setCellWhite(cell);
+
+    solver_.solve();
+
+    if (solver_.isSolved())
       break;
+
+    if (solver_.isTimedOut())
+      return false;
   }
+
+  if (! solver_.isSolved())
+    return false;
+
+  if (options_.minimise)
+    minimiseGivens(puzzle, givens);
+
+  return true;
 }
 
-CNurikabeGen::Cell *
+// remove givens not needed for a unique solution. Each trial starts from the recorded
+// numbers only deductions instead of solving from scratch (optionally also run the
+// naive re-solve to compare result and time)
+void
 CNurikabeGen::
-getCell(int row, int col)
+minimiseGivens(CNurikabe::Puzzle &puzzle, const Inds &givens)
 {
-  return &cells_[row*cols_ + col];
+  Inds inds = givens;
+
+  std::shuffle(inds.begin(), inds.end(), rand_);
+
+  std::vector<int> naiveValues;
+
+  if (options_.compareMinimise) {
+    auto start = std::chrono::steady_clock::now();
+
+    CNurikabe::Puzzle puzzle1 = puzzle;
+
+    for (std::size_t i = 0; i < inds.size(); ++i) {
+      int ind = inds[i];
+
+      puzzle1.values[ind] = CNurikabe::Cell::UNKNOWN;
+
+      if (! solve(puzzle1))
+        puzzle1.values[ind] = puzzle1.solution[ind];
+    }
+
+    naiveValues = puzzle1.values;
+
+    stats_.naiveMinimiseTime +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < inds.size(); ++i) {
+    int ind = inds[i];
+
+    puzzle.values[ind] = CNurikabe::Cell::UNKNOWN;
+
+    ++stats_.numMinimiseTrials;
+
+    if (! solveWarm(puzzle, givens))
+      puzzle.values[ind] = puzzle.solution[ind];
+  }
+
+  stats_.minimiseTime +=
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  if (options_.compareMinimise && naiveValues != puzzle.values)
+    ++stats_.numMinimiseMismatch;
+}
+
+// solve puzzle from scratch (ignoring its solution), true if solved and matches solution.
+// If record is set the deductions are saved as the base trace for solveWarm
+bool
+CNurikabeGen::
+solve(const CNurikabe::Puzzle &puzzle, bool record)
+{
+  CNurikabe::Puzzle puzzle1;
+
+  puzzle1.rows   = puzzle.rows;
+  puzzle1.cols   = puzzle.cols;
+  puzzle1.values = puzzle.values;
+
+  if (! solver_.init(puzzle1))
+    return false;
+
+  std::ostringstream os;
+
+  CNurikabeTraceWriter writer(os);
+
+  if (record) {
+    writer.start(puzzle1);
+
+    solver_.setTraceWriter(&writer);
+  }
+
+  solver_.startTimer();
+
+  solver_.solve();
+
+  if (record) {
+    solver_.setTraceWriter(nullptr);
+
+    writer.end();
+
+    baseTrace_ = os.str();
+  }
+
+  return isSolution(puzzle);
+}
+
+// solve puzzle with givens (cells set in puzzle values) starting from the base trace
+// deductions. These only used the numbers so still hold whatever givens are removed
+bool
+CNurikabeGen::
+solveWarm(const CNurikabe::Puzzle &puzzle, const Inds &givens)
+{
+  std::istringstream is(baseTrace_);
+
+  CNurikabeTraceReader reader(is);
+
+  if (reader.replay(solver_) < 0)
+    return solve(puzzle);
+
+  solver_.startTimer();
+
+  for (std::size_t i = 0; i < givens.size(); ++i) {
+    int ind = givens[i];
+
+    if (puzzle.values[ind] == CNurikabe::Cell::UNKNOWN)
+      continue;
+
+    CNurikabe::Cell *cell = solver_.getCell(CNurikabe::Coord(ind / cols_, ind % cols_));
+
+    if (! cell->isUnknown())
+      continue;
+
+    if (puzzle.values[ind] == CNurikabe::Cell::BLACK)
+      solver_.setCellBlack(cell);
+    else
+      solver_.setCellWhite(cell);
+  }
+
+  solver_.solve();
+
+  return isSolution(puzzle);
+}
+
+// check solver has solved board and matches puzzle solution
+bool
+CNurikabeGen::
+isSolution(const CNurikabe::Puzzle &puzzle) const
+{
+  if (! solver_.isSolved())
+    return false;
+
+  for (int i = 0; i < rows_*cols_; ++i) {
+    const CNurikabe::Cell *cell = solver_.getCell(CNurikabe::Coord(i / cols_, i % cols_));
+
+    if (cell->isBlack() != (puzzle.solution[i] == CNurikabe::Cell::BLACK))
+      return false;
+  }
+
+  return true;
 }
@@ -1,16 +1,150 @@
+#ifndef CNurikabeGen_H
+#define CNurikabeGen_H
+
+#include <CNurikabe.h>
+#include <CNurikabeWall.h>
+#include <CNurikabeRand.h>
+
+// puzzle generator: grows a connected black wall (no 2x2 blocks) from a random edge
+// cell, numbers each remaining white area and keeps boards which the deductive solver
+// can solve, so the solution is unique. With no givens and no escalations a board is
+// rejected as soon as the simple rules stall. Otherwise boards the solver stalls on can
+// be completed with black/white given cells, which can then be minimised. The wall and clues can be
+// constrained to a symmetry and clues to a fixed mask of cells.
 class CNurikabeGen {
+ public:
+  // wall/clue symmetry
+  enum Symmetry {
+    SYMMETRY_NONE,
+    SYMMETRY_ROT180, // half turn
+    SYMMETRY_ROT90,  // quarter turn (square boards)
+    SYMMETRY_MIRROR  // left/right reflection
+  };
+
+  // generator options
+  struct Options {
+    int    rows            { 15 };
+    int    cols            { 15 };
+    double blackFraction   { 0.6 };   // stop wall growth at this fraction of cells
+    int    maxIsland       { 5 };     // split white areas larger than this
+    int    maxGivens       { 0 };     // max black/white given cells added to make unique
+    bool   minimise        { false }; // remove redundant givens
+    bool   compareMinimise { false }; // also run naive minimisation for comparison
+    double timeout         { 0.25 };  // max secs per solve
+    int    escalations     { 0 };     // max solver limit escalations (< 0 no limit)
+
+    Symmetry          symmetry { SYMMETRY_NONE };
+    std::vector<char> clueMask; // rows*cols, non-zero for clue cells (empty for any)
+  };
+
+  // generation counts
+  struct Stats {
+    long numCandidates { 0 }; // boards generated
+    long numRejected   { 0 }; // boards with white areas which can't be split
+    long numUnsolved   { 0 }; // boards not unique (within givens and timeout)
+    long numUnique     { 0 }; // boards returned
+
+    long   numMinimiseTrials   { 0 };   // given removals tried
+    double minimiseTime        { 0.0 }; // secs minimising givens
+    double naiveMinimiseTime   { 0.0 }; // secs of naive minimisation (if compared)
+    long   numMinimiseMismatch { 0 };   // boards where naive result differed
+  };
+
+ public:
+  CNurikabeGen(const Options &options);
+
+  // seed stream of candidate seeds
+  void setSeed(uint64_t seed) { seeds_.seed(seed); }
+
+  // generate unique puzzle (with solution) from next candidate seed, false if
+  // candidate rejected
+  bool generate(CNurikabe::Puzzle &puzzle);
+
+  // generate candidate from seed (puzzle.seed), same options and seed give same puzzle
+  bool generate(CNurikabe::Puzzle &puzzle, uint64_t seed);
+
+  const Stats &getStats() const { return stats_; }
+
  private:
   struct Cell {
+    int value { CNurikabe::Cell::UNKNOWN };
+
+    bool isBlack  () const { return value == CNurikabe::Cell::BLACK; }
+    bool isUnknown() const { return value == CNurikabe::Cell::UNKNOWN; }
+
+    void setBlack  () { value = CNurikabe::Cell::BLACK; }
+    void setUnknown() { value = CNurikabe::Cell::UNKNOWN; }
   };
 
- public:
-  CNurikabeGen() { }
+  typedef std::vector<int> Inds;
+
+  bool generateSolution(CNurikabe::Puzzle &puzzle);
+
+  void growWall();
 
-  void generate(int rows, int cols);
+  bool splitAreas();
 
-  Cell &getCell(int row, int col);
+  void getAreas();
+
+  bool addClues();
+
+  int randEdge();
+
+  void addBlack(int ind);
+
+  void getOrbit(int ind, Inds &inds) const;
+
+  bool canAddOrbit(const Inds &inds) const;
+
+  void addOrbit(const Inds &inds, Inds &frontier);
+
+  void addNeighbours(int ind, Inds &inds) const;
+
+  bool makeUnique(CNurikabe::Puzzle &puzzle);
+
+  void minimiseGivens(CNurikabe::Puzzle &puzzle, const Inds &givens);
+
+  bool solve(const CNurikabe::Puzzle &puzzle, bool record=false);
+
+  bool solveWarm(const CNurikabe::Puzzle &puzzle, const Inds &givens);
+
+  bool isSolution(const CNurikabe::Puzzle &puzzle) const;
+
+  Cell &getCell(int ind) { return cells_[ind]; }
+
+  int randInt(int n) { return rand_.randInt(n); }
 
  private:
+  // solver used for uniqueness check (gives up after timeout)
+  class Solver : public CNurikabe {
+   public:
+    Solver() { }
+
+    void setTimeout(double secs) {
+      timer_.setTimeout(secs);
+
+      setObserver(secs > 0 ? &timer_ : nullptr);
+    }
+
+    void startTimer() { timer_.start(); }
+
+    bool isTimedOut() const { return timer_.isTimedOut(); }
+
+   private:
+    TimeoutObserver timer_;
+  };
+
+  Options           options_;
   int               rows_, cols_;
   std::vector<Cell> cells_;
+  CNurikabeWall     wall_;  // incremental 2x2/connectivity state of cells_ blacks
+  Inds              area_;  // area id per cell
+  std::vector<Inds> areas_; // cells per area
+  CNurikabeRand     seeds_; // candidate seeds
+  CNurikabeRand     rand_;  // candidate generator (seeded per candidate)
+  Solver            solver_;
+  Stats             stats_;
+  std::string       baseTrace_; // numbers only deductions of current board
 };
+
+#endif
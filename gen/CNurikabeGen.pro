@@ -0,0 +1,43 @@
+TEMPLATE = app
+
+CONFIG += console thread
+CONFIG -= qt app_bundle
+
+TARGET = CNurikabeGen
+
+DEPENDPATH += .
+
+QMAKE_CXXFLAGS += -std=c++17
+
+# solver trace (CNURIKABE_LOG) is compiled out of release builds
+CONFIG(release, debug|release): DEFINES += CNURIKABE_NO_TRACE
+
+#CONFIG += debug
+
+# Input
+SOURCES += \
+CNurikabeGen.cpp \
+../src/CNurikabe.cpp \
+../src/CNurikabeCorpus.cpp \
+../src/CNurikabeTrace.cpp
+
+HEADERS += \
+CNurikabeGen.h \
+../src/CNurikabe.h \
+../src/CNurikabeBitBoard.h \
+../src/CNurikabeBitKernels.h \
+../src/CNurikabeImplications.h \
+../src/CNurikabeLog.h \
+../src/CNurikabeNogoods.h \
+../src/CNurikabePatterns.h \
+../src/CNurikabeRand.h \
+../src/CNurikabeTrace.h \
+../src/CNurikabeWall.h \
+../src/CNurikabeCorpus.h
+
+DESTDIR     = ../bin
+OBJECTS_DIR = ../obj/gen
+
+INCLUDEPATH += \
+../src \
+.
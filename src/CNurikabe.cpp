@@ -1,11 +1,25 @@
 #include <CNurikabe.h>
+#include <CNurikabeBitBoard.h>
+#include <CNurikabeLog.h>
+#include <CNurikabePatterns.h>
+#include <CNurikabeTrace.h>
+#include <CNurikabeWall.h>
 
 #include <Puzzles.h>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
 #include <string>
 #include <map>
 #include <climits>
+#include <cmath>
 #include <sstream>
+#include <fstream>
+#include <iomanip>
 #include <cassert>
 #include <cstdlib>
 #include <stdexcept>
@@ -38,56 +52,49 @@ static void logicAssert(CNurikabe::Grid *g, bool c, const std::string &m) {
   if (! c) g->logicError(m);
 }
 
-static bool isLogging() {
-  static bool initialized;
-  static bool logging;
-
-  if (! initialized) {
-    initialized = true;
-    logging     = (getenv("CNURIKABE_LOG") != nullptr);
-  }
-
-  return logging;
-}
-
-static void logNoNL(const std::string &str) {
-  if (isLogging())
-    std::cerr << str;
-}
-
-static void log(const std::string &str) {
-  if (isLogging())
-    std::cerr << str << std::endl;
-}
-
-template<typename T>
-static std::string toString(const T &t) {
-  std::stringstream ss;
-  ss << t;
-  return ss.str();
-}
-
 std::string intToString(int number) {
   std::stringstream ss;
   ss << number;
   return ss.str();
 }
 
-static int randInt(int imax)
-{
-  return (rand() % imax);
-}
+// changed cells which are now black (or white)
+static CNurikabe::CoordArray changedCoords(CNurikabe::Grid *grid,
+                                           const CNurikabe::CoordArray &changes, bool black) {
+  CNurikabe::CoordArray coords;
 
-template<typename T>
-T set_index(const std::set<T> &s, int i) {
-  typename std::set<T>::const_iterator p = s.begin();
+  for (std::size_t i = 0; i < changes.size(); ++i) {
+    if (grid->getCell(changes[i])->isBlack() == black)
+      coords.push_back(changes[i]);
+  }
 
-  for (int i1 = 0; i1 < i; ++i1)
-    ++p;
+  return coords;
+}
 
-  return *p;
+static double elapsedSecs(const CNurikabe::TimePoint &start,
+                          const CNurikabe::TimePoint &end=std::chrono::steady_clock::now()) {
+  return std::chrono::duration<double>(end - start).count();
 }
 
+// adds time spent in scope to value when grid is profiling
+class ProfileTimer {
+ public:
+  ProfileTimer(const CNurikabe::Grid *grid, double &value) :
+   value_(grid->isProfiling() ? &value : nullptr) {
+    if (value_)
+      start_ = std::chrono::steady_clock::now();
+  }
+
+ ~ProfileTimer() {
+    if (value_)
+      *value_ += elapsedSecs(start_);
+  }
+
+ private:
+  double               *value_ { nullptr };
+  CNurikabe::TimePoint  start_;
+};
+
 //-------------
 
 CNurikabe::
@@ -126,17 +133,117 @@ init(const std::string &board_def, const std::string &solution_def)
   return true;
 }
 
+// same values as accepted by readBoardToken (number, unknown, white or black)
+static bool isValidCellValue(int value) {
+  return (value >= CNurikabe::Cell::UNKNOWN && value <= 0xFFFFFF && value != 0);
+}
+
+bool
+CNurikabe::
+init(const Puzzle &puzzle)
+{
+  if (puzzle.rows <= 0 || puzzle.cols <= 0) return false;
+
+  // check size before allocating cells
+  if (int64_t(puzzle.rows)*puzzle.cols > MAX_CELLS) return false;
+
+  int num_cells = puzzle.rows*puzzle.cols;
+
+  if (int(puzzle.values.size()) != num_cells)
+    return false;
+
+  if (puzzle.hasSolution() && int(puzzle.solution.size()) != num_cells)
+    return false;
+
+  for (int i = 0; i < num_cells; ++i) {
+    if (! isValidCellValue(puzzle.values[i]))
+      return false;
+
+    if (puzzle.hasSolution() && ! isValidCellValue(puzzle.solution[i]))
+      return false;
+  }
+
+  delete grid_;
+
+  grid_ = new Grid(this, puzzle.rows, puzzle.cols);
+
+  int max_value = 1;
+
+  for (int i = 0; i < num_cells; ++i) {
+    Cell *cell = grid_->getCell(Coord(i / puzzle.cols, i % puzzle.cols));
+
+    int value = puzzle.values[i];
+
+    cell->setValue(value);
+
+    if (puzzle.hasSolution())
+      cell->setSolution(puzzle.solution[i]);
+
+    max_value = std::max(max_value, value);
+  }
+
+  grid_->setMaxValue(max_value);
+
+  grid_->addRegions();
+
+  pendingChanges_.clear();
+
+  return true;
+}
+
+CNurikabe::Puzzle
+CNurikabe::
+getPuzzle() const
+{
+  Puzzle puzzle;
+
+  puzzle.rows = getNumRows();
+  puzzle.cols = getNumCols();
+
+  int num_cells = puzzle.rows*puzzle.cols;
+
+  puzzle.values.resize(num_cells);
+
+  bool hasSolution = false;
+
+  for (int i = 0; i < num_cells; ++i) {
+    const Cell *cell = getCell(Coord(i / puzzle.cols, i % puzzle.cols));
+
+    if      (cell->isNumber()) puzzle.values[i] = cell->getNumber();
+    else if (cell->isWhite ()) puzzle.values[i] = Cell::WHITE;
+    else if (cell->isBlack ()) puzzle.values[i] = Cell::BLACK;
+    else                       puzzle.values[i] = Cell::UNKNOWN;
+
+    if (cell->getSolution() != Cell::UNKNOWN)
+      hasSolution = true;
+  }
+
+  if (hasSolution) {
+    puzzle.solution.resize(num_cells);
+
+    for (int i = 0; i < num_cells; ++i) {
+      const Cell *cell = getCell(Coord(i / puzzle.cols, i % puzzle.cols));
+
+      puzzle.solution[i] = cell->getSolution();
+    }
+  }
+
+  return puzzle;
+}
+
 void
 CNurikabe::
 reset()
 {
+  pendingChanges_.clear();
+
   grid_->reset();
 }
 
-// _       = empty/unknown
-// .       = white
-// *       = black
-// 1-9,A-Z = numbered
+// _           = empty/unknown
+// .           = white
+// *           = black
+// 1-9,A-Z,a-z = numbered (1-61)
 
 bool
 CNurikabe::
@@ -175,6 +282,8 @@ parse(const std::string &board_def, const std::string &solution_def)
     return false;
 
   // create grid
+  delete grid_;
+
   grid_ = new Grid(this, num_rows, num_cols);
 
   int max_value = 1;
@@ -217,1198 +326,3321 @@ parse(const std::string &board_def, const std::string &solution_def)
   return true;
 }
 
-void
-CNurikabe::
-solve()
-{
-  setBusy(true);
+// tokenised board format:
+//   <rows> <cols>
+//   <rows*cols board tokens>
+//   [<rows*cols solution tokens>]
+//
+// _ = empty/unknown, . = white, * = black, <integer> = numbered
+// tokens are whitespace separated and # starts a comment to end of line
 
-  while (true) {
-    try {
-      grid_->solveStep();
+enum TokenRC {
+  TOKEN_OK,
+  TOKEN_END,
+  TOKEN_BAD
+};
 
-      break; // no change
-    }
-    catch (changedSignal &) {
-      grid_->resetChange();
-    }
-    catch (breakSignal &) {
-      grid_->resetCoords();
-      break;
+// read next board token directly from stream buffer
+static TokenRC readBoardToken(std::streambuf *buf, int &value) {
+  typedef std::char_traits<char> Traits;
+
+  int c = buf->sgetc();
+
+  // skip space and comments
+  while (c != Traits::eof()) {
+    if      (c == '#') {
+      while (c != Traits::eof() && c != '\n')
+        c = buf->snextc();
     }
-    catch (std::exception &e) {
-      grid_->resetCoords();
-      log(e.what());
+    else if (isspace(c))
+      c = buf->snextc();
+    else
       break;
-    }
   }
 
-  setBusy(false);
+  if (c == Traits::eof())
+    return TOKEN_END;
 
-  if (isSolved())
-    log("Complete");
-  else
-    log("No change");
-}
+  if (isdigit(c)) {
+    value = 0;
 
-bool
-CNurikabe::
-solveStep()
-{
-  bool changed = false;
+    while (c != Traits::eof() && isdigit(c)) {
+      value = 10*value + (c - '0');
 
-  setBusy(true);
+      if (value > 0xFFFFFF)
+        return TOKEN_BAD;
 
-  bool rc = true;
+      c = buf->snextc();
+    }
 
-  try {
-    grid_->solveStep();
-  }
-  catch (changedSignal &) {
-    changed = true;
-    grid_->resetChange();
-  }
-  catch (breakSignal &) {
-    grid_->resetCoords();
-    rc = false;
-  }
-  catch (std::exception &e) {
-    grid_->resetCoords();
-    log(e.what());
-    rc = false;
+    if (value == 0)
+      return TOKEN_BAD;
   }
+  else {
+    if      (c == '_') value = CNurikabe::Cell::UNKNOWN;
+    else if (c == '.') value = CNurikabe::Cell::WHITE;
+    else if (c == '*') value = CNurikabe::Cell::BLACK;
+    else               return TOKEN_BAD;
 
-  setBusy(false);
+    c = buf->snextc();
+  }
 
-  if      (isSolved())
-    log("Complete");
-  else if (rc && ! changed)
-    log("No change");
+  // token must be followed by separator
+  if (c != Traits::eof() && ! isspace(c) && c != '#')
+    return TOKEN_BAD;
 
-  return rc;
+  return TOKEN_OK;
 }
 
 bool
 CNurikabe::
-isSolved() const
+load(std::istream &is)
 {
-  return grid_->isSolved();
-}
+  std::streambuf *buf = is.rdbuf();
 
-CNurikabe::Solutions
-CNurikabe::
-getRegionSolutions(Region *region, int maxDepth) const
-{
-  region->setMaxDepth(maxDepth);
+  if (! buf) return false;
 
-  Solutions solutions = getRegionSolutions(region);
+  // read size
+  int num_rows = 0, num_cols = 0;
 
-  region->setMaxDepth(INT_MAX);
+  if (readBoardToken(buf, num_rows) != TOKEN_OK || num_rows <= 0) return false;
+  if (readBoardToken(buf, num_cols) != TOKEN_OK || num_cols <= 0) return false;
 
-  return solutions;
-}
+  // check size before allocating cells
+  if (int64_t(num_rows)*num_cols > MAX_CELLS) return false;
 
-CNurikabe::Solutions
-CNurikabe::
-getRegionSolutions(Region *region) const
-{
-  setBusy(true);
+  int num_cells = num_rows*num_cols;
 
-  const CNurikabe::Solutions &solutions = region->getSolutions();
+  // create grid
+  Grid *grid = new Grid(this, num_rows, num_cols);
 
-  setBusy(false);
+  int max_value = 1;
 
-  return solutions;
-}
+  // populate grid
 
-void
-CNurikabe::
-setCellBlack(Cell *cell)
-{
-  try {
-    getGrid()->startChange();
+  for (int i = 0; i < num_cells; ++i) {
+    int value;
 
-    cell->setBlack();
+    if (readBoardToken(buf, value) != TOKEN_OK) {
+      delete grid;
+      return false;
+    }
 
-    getGrid()->endChange("set black");
-  }
-  catch (changedSignal &) {
-  }
-  catch (...) {
-    throw;
+    Cell *cell = grid->getCell(Coord(i / num_cols, i % num_cols));
+
+    cell->setValue(value);
+
+    max_value = std::max(max_value, value);
   }
-}
 
-void
-CNurikabe::
-setCellWhite(Cell *cell)
-{
-  try {
-    getGrid()->startChange();
+  // optional solution
+  for (int i = 0; i < num_cells; ++i) {
+    int value;
 
-    cell->setWhite();
+    TokenRC rc = readBoardToken(buf, value);
 
-    getGrid()->endChange("set white");
-  }
-  catch (changedSignal &) {
-  }
-  catch (...) {
-    throw;
+    if (rc == TOKEN_END && i == 0)
+      break;
+
+    if (rc != TOKEN_OK) {
+      delete grid;
+      return false;
+    }
+
+    Cell *cell = grid->getCell(Coord(i / num_cols, i % num_cols));
+
+    cell->setSolution(value);
   }
+
+  delete grid_;
+
+  grid_ = grid;
+
+  grid_->setMaxValue(max_value);
+
+  grid_->addRegions();
+
+  pendingChanges_.clear();
+
+  return true;
 }
 
-void
+bool
 CNurikabe::
-playSolution(const Solution &solution, bool validate)
+loadFile(const std::string &filename)
 {
-  grid_->pushCoords(solution.ocoords, solution.icoords);
+  std::ifstream is(filename.c_str());
 
-  try {
-    grid_->rebuild(true);
+  if (! is)
+    return false;
 
-    if (validate)
-      solution.checkValid1(grid_);
-  }
-  catch (...) {
-  }
+  return load(is);
 }
 
 void
 CNurikabe::
-unplaySolution()
+save(std::ostream &os) const
 {
-  grid_->popCoords();
+  int num_rows = getNumRows();
+  int num_cols = getNumCols();
 
-  try {
-    grid_->rebuild(true);
+  // pad numbers to widest value
+  int width = 1;
+
+  for (int max_value = grid_->getMaxValue(); max_value >= 10; max_value /= 10)
+    ++width;
+
+  bool hasSolution = false;
+
+  os << num_rows << " " << num_cols << "\n";
+
+  for (int r = 0; r < num_rows; ++r) {
+    for (int c = 0; c < num_cols; ++c) {
+      const Cell *cell = getCell(Coord(r, c));
+
+      if (c > 0) os << " ";
+
+      if      (cell->isNumber()) os << std::setw(width) << cell->getNumber();
+      else if (cell->isWhite ()) os << std::setw(width) << ".";
+      else if (cell->isBlack ()) os << std::setw(width) << "*";
+      else                       os << std::setw(width) << "_";
+
+      if (cell->getSolution() != Cell::UNKNOWN)
+        hasSolution = true;
+    }
+
+    os << "\n";
   }
-  catch (...) {
+
+  if (! hasSolution)
+    return;
+
+  os << "\n";
+
+  for (int r = 0; r < num_rows; ++r) {
+    for (int c = 0; c < num_cols; ++c) {
+      const Cell *cell = getCell(Coord(r, c));
+
+      if (c > 0) os << " ";
+
+      int solution = cell->getSolution();
+
+      if      (cell->isNumber())          os << std::setw(width) << cell->getNumber();
+      else if (solution == Cell::WHITE)   os << std::setw(width) << ".";
+      else if (solution == Cell::BLACK)   os << std::setw(width) << "*";
+      else                                os << std::setw(width) << "_";
+    }
+
+    os << "\n";
   }
 }
 
-void
+bool
 CNurikabe::
-commit()
+saveFile(const std::string &filename) const
 {
-  grid_->commit();
+  std::ofstream os(filename.c_str());
+
+  if (! os)
+    return false;
+
+  save(os);
+
+  return bool(os);
 }
 
 void
 CNurikabe::
-updateBreak()
+solve()
 {
-  if (checkBreak())
-    break_signal();
-}
+  setBusy(true);
 
-int
+  while (true) {
+    try {
+      grid_->solveStep();
+
+      break; // no change
+    }
+    catch (changedSignal &) {
+      grid_->resetChange();
+    }
+    catch (breakSignal &) {
+      grid_->resetCoords();
+      break;
+    }
+    catch (std::exception &e) {
+      grid_->resetCoords();
+      CNURIKABE_TRACE(ERROR, "exception", "what", e.what());
+      break;
+    }
+  }
+
+  flushChanges();
+
+  setBusy(false);
+
+  CNURIKABE_TRACE(INFO, "solve", "solved", isSolved());
+}
+
+CNurikabe::SolveResult
 CNurikabe::
-getNumRows() const
+solve(const Puzzle &puzzle, const SolveOptions &options)
 {
-  return grid_->getNumRows();
+  SolveResult result;
+
+  CNurikabe nurikabe;
+
+  // only attach observer when needed so solve loops skip break checks
+  TimeoutObserver observer(options.timeout, options.observer);
+
+  if (options.observer || options.timeout > 0)
+    nurikabe.setObserver(&observer);
+
+  nurikabe.setMaxEscalations(options.maxEscalations);
+  nurikabe.setProbeThreads  (options.probeThreads);
+  nurikabe.setMaxSearchNodes(options.maxSearchNodes);
+  nurikabe.setProfiling     (options.profile);
+
+  if (! nurikabe.init(puzzle))
+    return result;
+
+  result.valid = true;
+
+  nurikabe.resetStats();
+
+  observer.start();
+
+  TimePoint start = std::chrono::steady_clock::now();
+
+  if      (options.grade)
+    nurikabe.grade(result.grade);
+  else if (! options.portfolio.empty()) {
+    int ind = nurikabe.solvePortfolio(options.portfolio, options.shareCells);
+
+    if (ind >= 0)
+      result.strategy = options.portfolio[ind].name;
+  }
+  else
+    nurikabe.solve();
+
+  result.time     = elapsedSecs(start);
+  result.solved   = nurikabe.isSolved();
+  result.timedOut = observer.isTimedOut();
+  result.stats    = nurikabe.getStats();
+
+  int num_rows = nurikabe.getNumRows();
+  int num_cols = nurikabe.getNumCols();
+
+  result.values.resize(num_rows*num_cols);
+
+  for (int r = 0; r < num_rows; ++r) {
+    for (int c = 0; c < num_cols; ++c) {
+      const Cell *cell = nurikabe.getCell(Coord(r, c));
+
+      int &value = result.values[r*num_cols + c];
+
+      if      (cell->isNumber()) value = cell->getNumber();
+      else if (cell->isBlack ()) value = Cell::BLACK;
+      else if (cell->isWhite ()) value = Cell::WHITE;
+      else                       value = Cell::UNKNOWN;
+    }
+  }
+
+  return result;
 }
 
-int
+void
 CNurikabe::
-getNumCols() const
+setStrategy(const Strategy &strategy)
 {
-  return grid_->getNumCols();
+  setProbing       (strategy.probe);
+  setEnumerating   (strategy.enumerate);
+  setMaxEscalations(strategy.maxEscalations);
+  setMaxSearchNodes(strategy.maxSearchNodes);
 }
 
-const CNurikabe::Cell *
+CNurikabe::Strategies
 CNurikabe::
-getCell(const Coord &coord) const
+defaultPortfolio()
 {
-  return grid_->getCell(coord);
+  Strategies strategies(3);
+
+  // all stages (cell search once enumeration is exhausted)
+  strategies[0].name = "default";
+
+  // enumeration only (no probing or search)
+  strategies[1].name           = "enumerate";
+  strategies[1].probe          = false;
+  strategies[1].maxSearchNodes = 0;
+
+  // cell search instead of enumeration
+  strategies[2].name           = "search";
+  strategies[2].enumerate      = false;
+  strategies[2].maxSearchNodes = 100000;
+
+  return strategies;
 }
 
-CNurikabe::Cell *
+int
 CNurikabe::
-getCell(const Coord &coord)
+solvePortfolio(const Strategies &strategies, bool shareCells)
 {
-  return grid_->getCell(coord);
+  int numStrategies = strategies.size();
+
+  if (numStrategies == 0) {
+    solve();
+
+    return -1;
+  }
+
+  setBusy(true);
+
+  Puzzle puzzle = getPuzzle();
+
+  int numCells = puzzle.rows*puzzle.cols;
+
+  // strategy solvers interrupted by shared stop flag
+  class StopObserver : public Observer {
+   public:
+    StopObserver(const std::atomic<bool> &stop) : stop_(stop) { }
+
+    bool checkBreak() override { return stop_; }
+
+   private:
+    const std::atomic<bool> &stop_;
+  };
+
+  std::atomic<bool> stop(false);
+
+  std::vector<std::unique_ptr<CNurikabe>>    solvers;
+  std::vector<std::unique_ptr<StopObserver>> observers;
+
+  for (int i = 0; i < numStrategies; ++i) {
+    solvers  .emplace_back(new CNurikabe);
+    observers.emplace_back(new StopObserver(stop));
+
+    CNurikabe *solver = solvers.back().get();
+
+    solver->setStrategy (strategies[i]);
+    solver->setProfiling(isProfiling());
+    solver->setObserver (observers.back().get());
+
+    solver->init(puzzle);
+  }
+
+  // cells deduced by any strategy (same values as puzzle)
+  std::mutex              mutex;
+  std::condition_variable cond;
+  std::vector<int>        known   = puzzle.values;
+  long                    version = 0;
+  int                     winner  = -1;
+
+  // strategies beyond the number of cores run after earlier ones finish (in order)
+  int numThreads = std::min(numStrategies, std::max(int(std::thread::hardware_concurrency()), 1));
+
+  std::atomic<int> next(0);
+
+  int running = numThreads;
+
+  auto publishCells = [&](CNurikabe *solver) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    bool changed = false;
+
+    for (int i = 0; i < numCells; ++i) {
+      if (known[i] != Cell::UNKNOWN) continue;
+
+      const Cell *cell = solver->getCell(Coord(i / puzzle.cols, i % puzzle.cols));
+
+      if      (cell->isBlack()) known[i] = Cell::BLACK;
+      else if (cell->isWhite()) known[i] = Cell::WHITE;
+      else                      continue;
+
+      changed = true;
+    }
+
+    if (changed)
+      ++version;
+  };
+
+  // apply cells deduced by other strategies, false if they contradict
+  auto importCells = [&](CNurikabe *solver, long &seen, bool &changed) {
+    std::vector<int> values;
+
+    {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    changed = (version > seen);
+
+    if (! changed) return true;
+
+    seen   = version;
+    values = known;
+    }
+
+    CoordArray blackCoords, whiteCoords;
+
+    for (int i = 0; i < numCells; ++i) {
+      Coord coord(i / puzzle.cols, i % puzzle.cols);
+
+      if (! solver->getCell(coord)->isUnknown()) continue;
+
+      if      (values[i] == Cell::BLACK) blackCoords.push_back(coord);
+      else if (values[i] == Cell::WHITE) whiteCoords.push_back(coord);
+    }
+
+    changed = (! blackCoords.empty() || ! whiteCoords.empty());
+
+    if (! changed) return true;
+
+    return solver->applyStep("portfolio shared", blackCoords, whiteCoords);
+  };
+
+  auto hasNewCells = [&](long seen) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    return (version > seen);
+  };
+
+  auto runStrategy = [&](int ind) {
+    CNurikabe *solver = solvers[ind].get();
+    Grid      *grid   = solver->grid_;
+
+    long seen = 0;
+
+    while (! stop) {
+      bool imported = false;
+
+      if (shareCells && ! importCells(solver, seen, imported))
+        break;
+
+      try {
+        grid->solveStep();
+
+        // no change so done unless other strategies found more cells
+        if (! imported && (! shareCells || ! hasNewCells(seen)))
+          break;
+      }
+      catch (changedSignal &) {
+        grid->resetChange();
+
+        publishCells(solver);
+      }
+      catch (breakSignal &) {
+        grid->resetCoords();
+        break;
+      }
+      catch (std::exception &e) {
+        grid->resetCoords();
+        CNURIKABE_TRACE(ERROR, "exception", "what", e.what());
+        break;
+      }
+    }
+
+    // cells set before interrupt
+    publishCells(solver);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if (winner < 0 && solver->isSolved()) {
+      winner = ind;
+
+      stop = true;
+    }
+  };
+
+  auto runStrategies = [&]() {
+    while (! stop) {
+      int ind = next++;
+
+      if (ind >= numStrategies) break;
+
+      runStrategy(ind);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    --running;
+
+    cond.notify_all();
+  };
+
+  std::vector<std::thread> threads;
+
+  for (int i = 0; i < numThreads; ++i)
+    threads.push_back(std::thread(runStrategies));
+
+  // wait for strategies (forwarding interrupt)
+  {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (running > 0) {
+    cond.wait_for(lock, std::chrono::milliseconds(10));
+
+    if (observer_ && observer_->checkBreak())
+      stop = true;
+  }
+  }
+
+  for (int i = 0; i < numThreads; ++i)
+    threads[i].join();
+
+  //---
+
+  // apply winning board (or all cells deduced)
+  if (winner >= 0) {
+    grid_->getStats() = solvers[winner]->getStats();
+
+    known.clear();
+
+    for (int i = 0; i < numCells; ++i) {
+      const Cell *cell = solvers[winner]->getCell(Coord(i / puzzle.cols, i % puzzle.cols));
+
+      known.push_back(cell->isBlack() ? int(Cell::BLACK) :
+                      cell->isWhite() ? int(Cell::WHITE) : int(Cell::UNKNOWN));
+    }
+  }
+
+  CoordArray blackCoords, whiteCoords;
+
+  for (int i = 0; i < numCells; ++i) {
+    Coord coord(i / puzzle.cols, i % puzzle.cols);
+
+    if (! getCell(coord)->isUnknown()) continue;
+
+    if      (known[i] == Cell::BLACK) blackCoords.push_back(coord);
+    else if (known[i] == Cell::WHITE) whiteCoords.push_back(coord);
+  }
+
+  // observer not checked so an interrupted solve keeps the deduced cells
+  Observer *observer = observer_;
+
+  observer_ = nullptr;
+
+  if (! blackCoords.empty() || ! whiteCoords.empty())
+    applyStep("portfolio", blackCoords, whiteCoords);
+
+  observer_ = observer;
+
+  getGrid()->rebuild();
+
+  flushChanges();
+
+  setBusy(false);
+
+  CNURIKABE_TRACE(INFO, "solvePortfolio", "winner", winner, "solved", isSolved());
+
+  return winner;
+}
+
+bool
+CNurikabe::
+solveStep()
+{
+  setBusy(true);
+
+  bool rc = true;
+
+  try {
+    grid_->solveStep();
+
+    CNURIKABE_TRACE(INFO, "solveStep", "changed", false);
+  }
+  catch (changedSignal &) {
+    grid_->resetChange();
+  }
+  catch (breakSignal &) {
+    grid_->resetCoords();
+    rc = false;
+  }
+  catch (std::exception &e) {
+    grid_->resetCoords();
+    CNURIKABE_TRACE(ERROR, "exception", "what", e.what());
+    rc = false;
+  }
+
+  flushChanges();
+
+  setBusy(false);
+
+  CNURIKABE_TRACE(INFO, "solveStep", "solved", isSolved());
+
+  return rc;
 }
 
 void
 CNurikabe::
-print() const
+grade(Grade &grade)
 {
-  print(std::cout);
+  grade = Grade();
+
+  long work = grid_->getStats().numSolutionNodes;
+
+  setBusy(true);
+
+  while (true) {
+    try {
+      grid_->solveStep();
+
+      break; // no change
+    }
+    catch (changedSignal &) {
+      grid_->resetChange();
+
+      Tier tier = grid_->getStepTier();
+
+      ++grade.numSteps[tier];
+
+      grade.tier = std::max(grade.tier, tier);
+    }
+    catch (breakSignal &) {
+      grid_->resetCoords();
+      break;
+    }
+    catch (std::exception &e) {
+      grid_->resetCoords();
+      CNURIKABE_TRACE(ERROR, "exception", "what", e.what());
+      break;
+    }
+  }
+
+  flushChanges();
+
+  setBusy(false);
+
+  grade.solved         = isSolved();
+  grade.numEscalations = grid_->getNumEscalations();
+  grade.maxRemaining   = grid_->getMaxRemaining();
+  grade.maxSolutions   = grid_->getMaxSolutions();
+  grade.work           = grid_->getStats().numSolutionNodes - work;
+
+  // tier dominates, then escalations, then (log) enumeration work and the share of
+  // deductions needing enumeration
+  int numSteps = 0;
+
+  for (int i = 0; i < NUM_TIERS; ++i)
+    numSteps += grade.numSteps[i];
+
+  double hardSteps = grade.numSteps[TIER_RECURSE] + grade.numSteps[TIER_ESCALATED] +
+                     grade.numSteps[TIER_SEARCH];
+
+  grade.score = 10.0*grade.tier + 2.0*grade.numEscalations + std::log10(1.0 + grade.work);
+
+  if (numSteps > 0)
+    grade.score += 5.0*hardSteps/numSteps;
+
+  CNURIKABE_TRACE(INFO, "grade", "solved", grade.solved, "tier", int(grade.tier),
+                  "escalations", grade.numEscalations, "score", grade.score);
+}
+
+bool
+CNurikabe::
+isSolved() const
+{
+  return grid_->isSolved();
 }
 
-void
-CNurikabe::
-print(std::ostream &os) const
-{
-  grid_->print(os);
-}
+CNurikabe::Solutions
+CNurikabe::
+getRegionSolutions(Region *region, int maxDepth) const
+{
+  region->setMaxDepth(maxDepth);
+
+  Solutions solutions = getRegionSolutions(region);
+
+  region->setMaxDepth(INT_MAX);
+
+  return solutions;
+}
+
+CNurikabe::Solutions
+CNurikabe::
+getRegionSolutions(Region *region) const
+{
+  setBusy(true);
+
+  const CNurikabe::Solutions &solutions = region->getSolutions();
+
+  setBusy(false);
+
+  return solutions;
+}
+
+void
+CNurikabe::
+setCellBlack(Cell *cell)
+{
+  try {
+    getGrid()->startChange();
+
+    cell->setBlack();
+
+    getGrid()->endChange("set black");
+  }
+  catch (changedSignal &) {
+  }
+  catch (...) {
+    throw;
+  }
+
+  flushChanges();
+}
+
+bool
+CNurikabe::
+applyStep(const std::string &rule, const CoordArray &blackCoords, const CoordArray &whiteCoords)
+{
+  try {
+    getGrid()->startChange();
+
+    for (std::size_t i = 0; i < blackCoords.size(); ++i)
+      getCell(blackCoords[i])->setBlack();
+
+    for (std::size_t i = 0; i < whiteCoords.size(); ++i)
+      getCell(whiteCoords[i])->setWhite();
+
+    getGrid()->endChange(rule);
+  }
+  catch (changedSignal &) {
+  }
+  catch (...) {
+    getGrid()->resetCoords();
+    return false;
+  }
+
+  return true;
+}
+
+void
+CNurikabe::
+setCellWhite(Cell *cell)
+{
+  try {
+    getGrid()->startChange();
+
+    cell->setWhite();
+
+    getGrid()->endChange("set white");
+  }
+  catch (changedSignal &) {
+  }
+  catch (...) {
+    throw;
+  }
+
+  flushChanges();
+}
+
+void
+CNurikabe::
+playSolution(const Solution &solution, bool validate)
+{
+  grid_->pushCoords(solution.ocoords, solution.icoords);
+
+  try {
+    grid_->rebuild(true);
+
+    if (validate)
+      solution.checkValid1(grid_);
+  }
+  catch (...) {
+  }
+}
+
+void
+CNurikabe::
+unplaySolution()
+{
+  grid_->popCoords();
+
+  try {
+    grid_->rebuild(true);
+  }
+  catch (...) {
+  }
+}
+
+void
+CNurikabe::
+commit()
+{
+  grid_->commit();
+
+  flushChanges();
+}
+
+void
+CNurikabe::
+addChanges(const CoordArray &changes)
+{
+  // only batched for observer
+  if (! observer_)
+    return;
+
+  pendingChanges_.insert(changes.begin(), changes.end());
+
+  // deliver when enough changes are pending or notify interval has expired
+  if (int(pendingChanges_.size()) >= notifyMaxChanges_) {
+    flushChanges();
+    return;
+  }
+
+  TimePoint now = std::chrono::steady_clock::now();
+
+  int msecs = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastNotify_).count();
+
+  if (msecs >= notifyInterval_)
+    flushChanges();
+}
+
+void
+CNurikabe::
+flushChanges()
+{
+  if (pendingChanges_.empty()) return;
+
+  Coords changes;
+
+  std::swap(changes, pendingChanges_);
+
+  lastNotify_ = std::chrono::steady_clock::now();
+
+  if (observer_)
+    observer_->notifyChanged(changes);
+}
+
+void
+CNurikabe::
+updateBreak()
+{
+  if (observer_ && observer_->checkBreak())
+    break_signal();
+}
+
+int
+CNurikabe::
+getNumRows() const
+{
+  return grid_->getNumRows();
+}
+
+int
+CNurikabe::
+getNumCols() const
+{
+  return grid_->getNumCols();
+}
+
+const CNurikabe::Cell *
+CNurikabe::
+getCell(const Coord &coord) const
+{
+  return grid_->getCell(coord);
+}
+
+CNurikabe::Cell *
+CNurikabe::
+getCell(const Coord &coord)
+{
+  return grid_->getCell(coord);
+}
+
+void
+CNurikabe::
+print() const
+{
+  print(std::cout);
+}
+
+void
+CNurikabe::
+print(std::ostream &os) const
+{
+  grid_->print(os);
+}
+
+void
+CNurikabe::
+generate(int rows, int cols)
+{
+  delete grid_;
+
+  grid_ = new Grid(this, rows, cols);
+
+  grid_->generate();
+}
+
+//-------------
+
+void
+CNurikabe::Stats::
+print(std::ostream &os) const
+{
+  os << "rebuilds " << numRebuilds << " (" << rebuildTime << "s)" <<
+        " checkValid " << numCheckValid << " (" << checkValidTime << "s)" <<
+        " solutions " << numSolutions << " nodes " << numSolutionNodes <<
+        " (" << solutionsTime << "s)" <<
+        " push " << numPushCoords << " pop " << numPopCoords <<
+        " probes " << numProbes << " (" << probeTime << "s)" <<
+        " search " << numSearchNodes << " conflicts " << numConflicts <<
+        " learned " << numLearned << " backjumps " << numBackjumps <<
+        " (" << searchTime << "s)" << std::endl;
+
+  if (rules.empty())
+    return;
+
+  // rules sorted by time spent
+  std::vector<RuleStatsMap::const_iterator> pr;
+
+  for (auto p = rules.begin(); p != rules.end(); ++p)
+    pr.push_back(p);
+
+  std::sort(pr.begin(), pr.end(), [](RuleStatsMap::const_iterator p1,
+                                     RuleStatsMap::const_iterator p2) {
+    return p1->second.time > p2->second.time;
+  });
+
+  os << std::left << std::setw(36) << "rule" << std::right <<
+        std::setw(10) << "calls" << std::setw(10) << "fired" <<
+        std::setw(10) << "cells" << std::setw(12) << "time" << std::endl;
+
+  for (std::size_t i = 0; i < pr.size(); ++i) {
+    const RuleStats &ruleStats = pr[i]->second;
+
+    os << std::left << std::setw(36) << pr[i]->first << std::right <<
+          std::setw(10) << ruleStats.numCalls << std::setw(10) << ruleStats.numFired <<
+          std::setw(10) << ruleStats.numCells <<
+          std::setw(12) << std::fixed << std::setprecision(6) << ruleStats.time <<
+          std::defaultfloat << std::endl;
+  }
+}
+
+void
+CNurikabe::Stats::
+printJson(std::ostream &os) const
+{
+  os << "{ \"rebuilds\": " << numRebuilds << ", \"rebuildTime\": " << rebuildTime <<
+        ", \"checkValid\": " << numCheckValid << ", \"checkValidTime\": " << checkValidTime <<
+        ", \"solutions\": " << numSolutions << ", \"solutionNodes\": " << numSolutionNodes <<
+        ", \"solutionsTime\": " << solutionsTime <<
+        ", \"pushCoords\": " << numPushCoords << ", \"popCoords\": " << numPopCoords <<
+        ", \"probes\": " << numProbes << ", \"probeTime\": " << probeTime <<
+        ", \"searchNodes\": " << numSearchNodes << ", \"conflicts\": " << numConflicts <<
+        ", \"learned\": " << numLearned << ", \"backjumps\": " << numBackjumps <<
+        ", \"searchTime\": " << searchTime <<
+        ", \"rules\": [";
+
+  for (auto p = rules.begin(); p != rules.end(); ++p) {
+    const RuleStats &ruleStats = p->second;
+
+    os << (p != rules.begin() ? ", " : "") <<
+          "{ \"name\": ";
+
+    CNurikabeLog::writeString(os, p->first.c_str());
+
+    os << ", \"calls\": " << ruleStats.numCalls <<
+          ", \"fired\": " << ruleStats.numFired << ", \"cells\": " << ruleStats.numCells <<
+          ", \"time\": " << ruleStats.time << " }";
+  }
+
+  os << "] }";
+}
+
+//-------------
+
+CNurikabe::Grid::
+Grid(CNurikabe *nurikabe, int num_rows, int num_cols) :
+ nurikabe_(nurikabe), num_rows_(num_rows), num_cols_(num_cols), max_value_(1),
+ changed_(true), changing_(0), maxRemaining_(8), maxSolutions_(4096),
+ numEscalations_(0), stepTier_(TIER_NONE), numIncomplete_(INT_MAX)
+{
+  cells_.resize(num_rows_*num_cols_);
+
+  for (int i = 0, r = 0; r < num_rows_; ++r)
+    for (int c = 0; c < num_cols_; ++c, ++i)
+      cells_[i] = new Cell(this, Cell::UNKNOWN, Coord(r, c));
+
+  implications_.resize(num_rows_*num_cols_);
+
+  bitKernels_.resize(num_rows_, num_cols_);
+
+  int n = num_rows_*num_cols_;
+
+  colorBits_.black  .resize(n);
+  colorBits_.white  .resize(n);
+  colorBits_.numbers.resize(n);
+  colorBits_.unknown.resize(n);
+
+  workBits1_.resize(n);
+  workBits2_.resize(n);
+}
+
+CNurikabe::Grid::
+~Grid()
+{
+  CellArray::iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1)
+    delete *pc1;
+
+  Regions::iterator pr1, pr2;
+
+  for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1)
+    delete *pr1;
+
+  // pools, islands and gaps are either in use or in free list
+  for (Pools::iterator pp1 = pools_.begin(); pp1 != pools_.end(); ++pp1)
+    delete *pp1;
+
+  for (PoolArray::iterator pp1 = poolsArray_.begin(); pp1 != poolsArray_.end(); ++pp1)
+    delete *pp1;
+
+  for (Islands::iterator pi1 = islands_.begin(); pi1 != islands_.end(); ++pi1)
+    delete *pi1;
+
+  for (IslandArray::iterator pi1 = islandsArray_.begin(); pi1 != islandsArray_.end(); ++pi1)
+    delete *pi1;
+
+  for (Gaps::iterator pg1 = gaps_.begin(); pg1 != gaps_.end(); ++pg1)
+    delete *pg1;
+
+  for (GapArray::iterator pg1 = gapsArray_.begin(); pg1 != gapsArray_.end(); ++pg1)
+    delete *pg1;
+
+  for (std::size_t i = 0; i < probeCopies_.size(); ++i)
+    delete probeCopies_[i];
+}
+
+void
+CNurikabe::Grid::
+reset()
+{
+  CellArray::iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    cell->reset();
+  }
+
+  //------
+
+  Pools::const_iterator pp1, pp2;
+
+  for (pp1 = pools_.begin(), pp2 = pools_.end(); pp1 != pp2; ++pp1)
+    deletePool(*pp1);
+
+  pools_.clear();
+
+  //------
+
+  Islands::const_iterator pi1, pi2;
+
+  for (pi1 = islands_.begin(), pi2 = islands_.end(); pi1 != pi2; ++pi1)
+    deleteIsland(*pi1);
+
+  islands_.clear();
+
+  //------
+
+  Gaps::const_iterator pg1, pg2;
+
+  for (pg1 = gaps_.begin(), pg2 = gaps_.end(); pg1 != pg2; ++pg1)
+    deleteGap(*pg1);
+
+  gaps_.clear();
+
+  //------
+
+  blackCoords_.clear();
+  whiteCoords_.clear();
+
+  coordsStack_.clear();
+  countsStack_.clear();
+
+  resetColorBits();
+
+  implications_.clear();
+  nogoods_     .clear();
+
+  probeIdle_ = false;
+
+  maxRemaining_ = 8;
+  maxSolutions_ = 16;
+
+  numEscalations_ = 0;
+
+  addRegions();
+
+  rebuild();
+}
+
+void
+CNurikabe::Grid::
+addRegions()
+{
+  Regions::const_iterator pr1, pr2;
+
+  for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1)
+    delete *pr1;
+
+  regions_.clear();
+
+  CellArray::iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    if (! cell->isNumber()) continue;
+
+    Region *region = new Region(this, cell);
+
+    regions_.insert(region);
+  }
+
+  countCells();
+
+  setChanged();
+}
+
+// recount black, white and unknown cells and sum of clues
+void
+CNurikabe::Grid::
+countCells()
+{
+  counts_  = CellCounts();
+  clueSum_ = 0;
+
+  CellArray::const_iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    if      (cell->isBlack())
+      ++counts_.numBlack;
+    else if (cell->isNumberOrWhite())
+      ++counts_.numWhite;
+    else
+      ++counts_.numUnknown;
+
+    if (cell->isNumber())
+      clueSum_ += cell->getNumber();
+  }
+}
+
+CNurikabe::Pool *
+CNurikabe::Grid::
+createPool()
+{
+  Pool *pool;
+
+  if (poolsArray_.empty())
+    pool = new Pool(this);
+  else {
+    pool = poolsArray_.back();
+
+    poolsArray_.pop_back();
+
+    pool->reset();
+  }
+
+  pools_.insert(pool);
+
+  return pool;
+}
+
+void
+CNurikabe::Grid::
+deletePool(Pool *pool)
+{
+  pool->reset();
+
+  poolsArray_.push_back(pool);
+
+  pools_.erase(pool);
+}
+
+CNurikabe::Island *
+CNurikabe::Grid::
+createIsland()
+{
+  Island *island;
+
+  if (islandsArray_.empty())
+    island = new Island(this);
+  else {
+    island = islandsArray_.back();
+
+    islandsArray_.pop_back();
+
+    island->reset();
+  }
+
+  islands_.insert(island);
+
+  return island;
+}
+
+void
+CNurikabe::Grid::
+deleteIsland(Island *island)
+{
+  island->reset();
+
+  if (islands_.find(island) != islands_.end()) {
+    islandsArray_.push_back(island);
+
+    islands_.erase(island);
+  }
+}
+
+CNurikabe::Gap *
+CNurikabe::Grid::
+createGap()
+{
+  Gap *gap;
+
+  if (gapsArray_.empty())
+    gap = new Gap(this);
+  else {
+    gap = gapsArray_.back();
+
+    gapsArray_.pop_back();
+
+    gap->reset();
+  }
+
+  gaps_.insert(gap);
+
+  return gap;
+}
+
+void
+CNurikabe::Grid::
+deleteGap(Gap *gap)
+{
+  gap->reset();
+
+  if (gaps_.find(gap) != gaps_.end()) {
+    gapsArray_.push_back(gap);
+
+    gaps_.erase(gap);
+  }
+}
+
+const CNurikabe::Cell *
+CNurikabe::Grid::
+getCell(const Coord &coord) const
+{
+  return cells_[coord.row*num_cols_ + coord.col];
+}
+
+CNurikabe::Cell *
+CNurikabe::Grid::
+getCell(const Coord &coord)
+{
+  return cells_[coord.row*num_cols_ + coord.col];
+}
+
+void
+CNurikabe::Grid::
+setChanged(bool changed)
+{
+  changed_ = changed;
+
+  if (changed)
+    resetColorBits();
+
+  if (changed && getCoordDepth() == 0) {
+    Regions::iterator pr1, pr2;
+
+    for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1) {
+      Region *region = *pr1;
+
+      region->setChanged();
+    }
+  }
+}
+
+void
+CNurikabe::Grid::
+pushCoords(const Coords &blackCoords, const Coords &whiteCoords)
+{
+  ++stats_.numPushCoords;
+
+  coordsStack_.push_back(CoordsPair(blackCoords_, whiteCoords_));
+  countsStack_.push_back(counts_);
+
+  resetColorBits();
+
+  // only count cells which are currently unknown
+  Coords::const_iterator pc1, pc2;
+
+  for (pc1 = blackCoords.begin(), pc2 = blackCoords.end(); pc1 != pc2; ++pc1) {
+    if (getCell(*pc1)->isUnknown())
+      addCount(Cell::BLACK);
+
+    blackCoords_.insert(*pc1);
+  }
+
+  for (pc1 = whiteCoords.begin(), pc2 = whiteCoords.end(); pc1 != pc2; ++pc1) {
+    if (getCell(*pc1)->isUnknown())
+      addCount(Cell::WHITE);
+
+    whiteCoords_.insert(*pc1);
+  }
+}
+
+void
+CNurikabe::Grid::
+popCoords()
+{
+  ++stats_.numPopCoords;
+
+  resetColorBits();
+
+  if (! coordsStack_.empty()) {
+    CoordsPair coordsPair = coordsStack_.back();
+
+    coordsStack_.pop_back();
+
+    blackCoords_ = coordsPair.first;
+    whiteCoords_ = coordsPair.second;
+
+    counts_ = countsStack_.back();
+
+    countsStack_.pop_back();
+  }
+  else {
+    blackCoords_.clear();
+    whiteCoords_.clear();
+
+    countCells();
+  }
+}
+
+void
+CNurikabe::Grid::
+resetCoords()
+{
+  resetChange();
+
+  blackCoords_.clear();
+  whiteCoords_.clear();
+
+  coordsStack_.clear();
+
+  resetColorBits();
+
+  // restore top level totals
+  if (! countsStack_.empty()) {
+    counts_ = countsStack_.front();
+
+    countsStack_.clear();
+  }
+
+  rebuild(true);
+}
+
+void
+CNurikabe::Grid::
+commit()
+{
+  try {
+    Coords blackCoords = blackCoords_;
+    Coords whiteCoords = whiteCoords_;
+
+    resetCoords();
+
+    startChange();
+
+    Coords::const_iterator pc1, pc2;
+
+    for (pc1 = blackCoords.begin(), pc2 = blackCoords.end(); pc1 != pc2; ++pc1) {
+      Cell *cell = getCell(*pc1);
+
+      cell->setBlack();
+    }
+
+    for (pc1 = whiteCoords.begin(), pc2 = whiteCoords.end(); pc1 != pc2; ++pc1) {
+      Cell *cell = getCell(*pc1);
+
+      cell->setWhite();
+    }
+
+    endChange("commit");
+  }
+  catch (...) {
+  }
+}
+
+void
+CNurikabe::Grid::
+addBlackCoord(const Coord &coord)
+{
+  if (blackCoords_.insert(coord).second)
+    addCount(Cell::BLACK);
+
+  setChanged();
+}
+
+void
+CNurikabe::Grid::
+addWhiteCoord(const Coord &coord)
+{
+  if (whiteCoords_.insert(coord).second)
+    addCount(Cell::WHITE);
+
+  setChanged();
+}
+
+void
+CNurikabe::Grid::
+rebuild(bool force)
+{
+  if (changed_ || force) {
+    ++stats_.numRebuilds;
+
+    ProfileTimer timer(this, stats_.rebuildTime);
+
+    CellArray::iterator pc1, pc2;
+
+    for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+      Cell *cell = *pc1;
+
+      cell->resetPointers();
+    }
+
+    buildRegions();
+    buildPools();
+    buildIslands();
+    buildGaps();
+
+    changed_ = false;
+  }
+}
+
+void
+CNurikabe::Grid::
+buildRegions()
+{
+  numIncomplete_ = 0;
+
+  // build regions for number cells
+  CellArray::iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    if (! cell->isNumber()) continue;
+
+    Region *region = cell->getRegion();
+
+    region->build();
+
+    if (region->isComplete())
+      ++numIncomplete_;
+  }
+}
+
+void
+CNurikabe::Grid::
+buildIslands()
+{
+  // delete existing islands
+  Islands::iterator pi1, pi2;
+
+  for (pi1 = islands_.begin(), pi2 = islands_.end(); pi1 != pi2; ++pi1) {
+    Island *island = *pi1;
+
+    island->reset();
+
+    islandsArray_.push_back(island);
+  }
+
+  islands_.clear();
+
+  // build islands for isolated white cells
+  CellArray::iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    if (! cell->isWhite()) continue;
+
+    if (cell->inRegion() || cell->inIsland()) continue;
+
+    cell->buildIsland();
+  }
+}
+
+void
+CNurikabe::Grid::
+buildPools()
+{
+  // delete existing pools
+  Pools::iterator pp1, pp2;
+
+  for (pp1 = pools_.begin(), pp2 = pools_.end(); pp1 != pp2; ++pp1) {
+    Pool *pool = *pp1;
+
+    pool->reset();
+
+    poolsArray_.push_back(pool);
+  }
+
+  pools_.clear();
+
+  // clear pool pointers
+  CellArray::iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    cell->resetPoolPointer();
+  }
+
+  // build pools for black cells
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    if (! cell->isBlack()) continue;
+
+    if (cell->inPool()) continue;
+
+    cell->buildPool();
+  }
+}
+
+void
+CNurikabe::Grid::
+buildGaps()
+{
+  // delete existing gaps
+  Gaps::iterator pg1, pg2;
+
+  for (pg1 = gaps_.begin(), pg2 = gaps_.end(); pg1 != pg2; ++pg1) {
+    Gap *gap = *pg1;
+
+    gap->reset();
+
+    gapsArray_.push_back(gap);
+  }
+
+  gaps_.clear();
+
+  //------
+
+  // build gaps for unknown cells
+  CellArray::iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    if (! cell->isUnknown()) continue;
+
+    if (cell->inGap()) continue;
+
+    cell->buildGap();
+  }
+}
+
+bool
+CNurikabe::Grid::
+isSolved() const
+{
+  if (getNumUnknown() != 0)
+    return false;
+
+  // all regions must be complete
+  const Regions &regions = getRegions();
+
+  Regions::const_iterator pr1, pr2;
+
+  for (pr1 = regions.begin(), pr2 = regions.end(); pr1 != pr2; ++pr1) {
+    Region *region = *pr1;
+
+    if (! region->isComplete())
+      return false;
+  }
+
+  // single black pool
+  if (getNumPools() != 1)
+    return false;
+
+  // no isolated whites
+  if (getNumIslands() != 0)
+    return false;
+
+  // no gaps
+  if (getNumGaps() != 0)
+    return false;
+
+  return true;
+}
+
+bool
+CNurikabe::Grid::
+checkValid(int maxSteps)
+{
+  ++stats_.numCheckValid;
+
+  ProfileTimer timer(this, stats_.checkValidTime);
+
+  if (! checkCounts())
+    return false;
+
+  // do as many simple steps as we can (or are allowed)
+  for (int step = 0; maxSteps < 0 || step < maxSteps; ++step) {
+    try {
+      simpleSolveStep();
+      break; // no change so we are done
+    }
+    catch (changedSignal &) {
+      resetChange();
+    }
+    catch (breakSignal &) {
+      resetCoords();
+      break_signal();
+    }
+    catch (...) {
+      resetChange();
+      return false;
+    }
+  }
+
+  updateBreak();
+
+  //------
+
+  // validate new board
+
+  rebuild();
+
+  //------
+
+  if (! checkBlacksValid())
+    return false;
+
+  const Pools &pools = getPools();
+
+  Pools::const_iterator pp1, pp2;
+
+  for (pp1 = pools.begin(), pp2 = pools.end(); pp1 != pp2; ++pp1) {
+    Pool *pool = *pp1;
+
+    if (! pool->isValid())
+      return false;
+  }
+
+  //------
+
+  const Regions &regions = getRegions();
+
+  Regions::const_iterator pr1, pr2;
+
+  for (pr1 = regions.begin(), pr2 = regions.end(); pr1 != pr2; ++pr1) {
+    Region *region = *pr1;
+
+    if (! region->isValid())
+      return false;
+  }
+
+  //------
+
+  const Islands &islands = getIslands();
+
+  Islands::const_iterator pi1, pi2;
+
+  for (pi1 = islands.begin(), pi2 = islands.end(); pi1 != pi2; ++pi1) {
+    Island *island = *pi1;
+
+    if (! island->isValid())
+      return false;
+  }
+
+  //------
+
+  const Gaps &gaps = getGaps();
+
+  Gaps::const_iterator pg1, pg2;
+
+  for (pg1 = gaps.begin(), pg2 = gaps.end(); pg1 != pg2; ++pg1) {
+    Gap *gap = *pg1;
+
+    if (! gap->isValid())
+      return false;
+  }
+
+  //------
+
+  if (isSolved()) {
+    //std::cout << "Final Solution" << std::endl;
+
+    // ensure blacks make single pool
+    if (getNumPools() > 1)
+      return false;
+  }
+
+  //------
+
+  // got here so valid
+
+  return true;
+}
+
+void
+CNurikabe::Grid::
+solveStep()
+{
+  CNURIKABE_TRACE(TRACE, "solveStep");
+
+  nextMaxRemaining_ = -1;
+  nextMaxSolutions_ = false;
+
+  stepTier_ = TIER_SIMPLE;
+
+  simpleSolveStep();
+
+  // cheaper than region enumeration so try first, unless last probe found nothing
+  // in which case only probe when enumeration finds nothing
+  bool probing     = nurikabe_->isProbing();
+  bool enumerating = nurikabe_->isEnumerating();
+
+  if (probing && ! probeIdle_) {
+    stepTier_ = TIER_PROBE;
+
+    probeSolveStep();
+  }
+
+  if (enumerating) {
+    stepTier_ = (numEscalations_ > 0 ? TIER_ESCALATED : TIER_RECURSE);
+
+    recurseSolveStep();
+  }
+
+  if (probing && probeIdle_) {
+    stepTier_ = TIER_PROBE;
+
+    probeSolveStep();
+  }
+
+  // if got here then no change
+
+  // try uping max remaining and max solutions
+  while (enumerating && escalateLimits()) {
+    stepTier_ = TIER_SIMPLE;
+
+    simpleSolveStep();
+
+    stepTier_ = TIER_ESCALATED;
+
+    recurseSolveStep();
+  }
+
+  // limits can't be raised so try arc consistency of last enumeration's solutions
+  if (enumerating) {
+    stepTier_ = (numEscalations_ > 0 ? TIER_ESCALATED : TIER_RECURSE);
+
+    pruneSolveStep();
+  }
+
+  // last resort: search cells (learning nogoods from contradictions)
+  if (nurikabe_->getMaxSearchNodes() > 0) {
+    stepTier_ = TIER_SEARCH;
+
+    searchSolveStep();
+  }
+}
+
+// Failed literal probing: assume each unknown cell black and then white and apply the
+// simple rules (checkValid). If one assumption fails the cell must be the other color.
+//
+// Probes are independent so run on copies of the current board (one per thread) and
+// the forced cells of all probes are merged afterwards, so results don't depend on the
+// thread count. Copies are kept between steps and brought up to date with the board's
+// cells, cell region constraints, implications and nogoods (syncProbeCopy).
+void
+CNurikabe::Grid::
+probeSolveStep()
+{
+  CNURIKABE_TRACE(TRACE, "probeSolveStep");
+
+  markProfile();
+
+  ProfileTimer timer(this, stats_.probeTime);
+
+  // probe unknown cells next to a known cell (others rarely fail)
+  CoordArray knownCoords;
+
+  getFrontierCoords(knownCoords);
+
+  int numCoords = knownCoords.size();
+
+  if (numCoords == 0) return;
+
+  int numThreads = std::min(nurikabe_->getProbeThreads(), numCoords);
+
+  while (int(probeCopies_.size()) < numThreads)
+    probeCopies_.push_back(new CNurikabe);
+
+  for (int i = 0; i < numThreads; ++i) {
+    CNurikabe *copy = probeCopies_[i];
+
+    if (copy->grid_ && copy->grid_->syncProbeCopy(this))
+      continue;
+
+    Puzzle puzzle = nurikabe_->getPuzzle();
+
+    puzzle.solution.clear();
+
+    copy->init(puzzle);
+
+    copy->grid_->syncProbeCopy(this);
+  }
+
+  // per cell: 1 if black fails, 2 if white fails
+  std::vector<char> failed(numCoords, 0);
+
+  // probes stop at the end of the chunk with the first failure (by index) so the
+  // probed cells, and so the result, don't depend on the number of threads
+  const int chunkSize = 8;
+
+  std::atomic<int>  next(0);
+  std::atomic<int>  limit(numCoords);
+  std::atomic<long> numProbes(0);
+  std::atomic<bool> stop(false);
+
+  // probe cells in turn on copy of board (main copy checks for interrupt)
+  auto probeCells = [&](int ind) {
+    Grid *grid = probeCopies_[ind]->grid_;
+
+    while (! stop) {
+      int i = next++;
+
+      if (i >= limit) break;
+
+      if (ind == 0)
+        updateBreak();
+
+      const Coord &coord = knownCoords[i];
+
+      ++numProbes;
+
+      if (! grid->probeCell(coord, true))
+        failed[i] = 1;
+      else {
+        ++numProbes;
+
+        if (! grid->probeCell(coord, false))
+          failed[i] = 2;
+      }
+
+      if (failed[i]) {
+        int limit1 = limit;
+        int limit2 = std::min((i/chunkSize + 1)*chunkSize, numCoords);
+
+        while (limit2 < limit1 && ! limit.compare_exchange_weak(limit1, limit2)) { }
+      }
+    }
+  };
+
+  std::vector<std::thread> threads;
+
+  for (int i = 1; i < numThreads; ++i)
+    threads.push_back(std::thread(probeCells, i));
+
+  try {
+    probeCells(0);
+  }
+  catch (...) {
+    stop = true;
+
+    for (std::size_t i = 0; i < threads.size(); ++i)
+      threads[i].join();
+
+    throw;
+  }
+
+  for (std::size_t i = 0; i < threads.size(); ++i)
+    threads[i].join();
+
+  stats_.numProbes += numProbes;
+
+  //---
+
+  probeIdle_ = true;
+
+  startChange();
+
+  for (int i = 0; i < limit; ++i) {
+    if (! failed[i]) continue;
+
+    probeIdle_ = false;
+
+    Cell *cell = getCell(knownCoords[i]);
+
+    if (failed[i] == 1)
+      cell->setWhite();
+    else
+      cell->setBlack();
+  }
+
+  endChange("failed literal probe");
+}
+
+// assume cell black (or white) and check simple rules find no contradiction
+//
+// The board's regions, pools etc are left for the pushed cells (marked changed) and
+// only rebuilt when next needed, i.e. once by the next probe rather than after each pop.
+bool
+CNurikabe::Grid::
+probeCell(const Coord &coord, bool black)
+{
+  Coords blackCoords, whiteCoords;
+
+  if (black)
+    blackCoords.insert(coord);
+  else
+    whiteCoords.insert(coord);
+
+  bool valid = true;
+
+  pushCoords(blackCoords, whiteCoords);
+
+  setChanged();
+
+  try {
+    valid = checkValid();
+  }
+  catch (...) {
+    valid = false;
+  }
+
+  popCoords();
+
+  setChanged();
+
+  return valid;
+}
+
+// bring probe copy (this, at top level) up to date with top level of grid (same puzzle):
+// known cells, cell region constraints, implications and nogoods. Returns false if this
+// has a cell grid doesn't (e.g. grid was reset) so copy must be reinitialized.
+bool
+CNurikabe::Grid::
+syncProbeCopy(const Grid *grid)
+{
+  if (num_rows_ != grid->num_rows_ || num_cols_ != grid->num_cols_)
+    return false;
+
+  // structures may be left from last probe
+  rebuild();
+
+  int n = cells_.size();
+
+  CoordArray blackCoords, whiteCoords;
+
+  for (int i = 0; i < n; ++i) {
+    const Cell *cell  = cells_[i];
+    const Cell *cell1 = grid->cells_[i];
+
+    if (cell->isNumber() != cell1->isNumber())
+      return false;
+
+    if      (cell->isBlack()) {
+      if (! cell1->isBlack()) return false;
+    }
+    else if (cell->isWhite()) {
+      if (! cell1->isWhite()) return false;
+    }
+    else if (cell->isUnknown()) {
+      if      (cell1->isBlack()) blackCoords.push_back(cell->getCoord());
+      else if (cell1->isWhite()) whiteCoords.push_back(cell->getCoord());
+    }
+  }
+
+  if ((! blackCoords.empty() || ! whiteCoords.empty()) &&
+      ! nurikabe_->applyStep("probe sync", blackCoords, whiteCoords))
+    return false;
+
+  for (int i = 0; i < n; ++i)
+    cells_[i]->copyRegionConstraint(grid->cells_[i]);
+
+  implications_ = grid->implications_;
+  nogoods_      = grid->nogoods_;
+
+  setChanged();
+
+  return true;
+}
+
+// get unknown cells next to a known cell or the edge, most known neighbours first
+void
+CNurikabe::Grid::
+getFrontierCoords(CoordArray &coords) const
+{
+  std::vector<std::pair<int, Coord>> knownCoords;
+
+  CellArray::const_iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    if (! cell->isUnknown()) continue;
+
+    Cell *cells[4] = { cell->getN(), cell->getS(), cell->getE(), cell->getW() };
+
+    int numKnown = 0;
+
+    for (int i = 0; i < 4; ++i) {
+      if (! cells[i] || ! cells[i]->isUnknown())
+        ++numKnown;
+    }
+
+    if (numKnown > 0)
+      knownCoords.push_back(std::make_pair(-numKnown, cell->getCoord()));
+  }
+
+  std::stable_sort(knownCoords.begin(), knownCoords.end(),
+    [](const std::pair<int, Coord> &p1, const std::pair<int, Coord> &p2) {
+      return p1.first < p2.first;
+    });
+
+  coords.clear();
+
+  for (std::size_t i = 0; i < knownCoords.size(); ++i)
+    coords.push_back(knownCoords[i].second);
+}
+
+// Cell search: once enumeration is exhausted find a solution by deciding cell colors
+// (simple rules and learned nogoods propagate each decision), then try to refute the
+// other color of each frontier cell. A refuted color is a deduction.
+//
+// Each contradiction is reduced to a smaller set of decisions which still fail from the
+// top level board (the latest decisions before the failed one are dropped while the
+// rest still fail) and stored as a nogood, so the same contradiction is not found again
+// on other branches or in later searches. The search then jumps back over the dropped
+// decisions and asserts the negation of the failed one.
+void
+CNurikabe::Grid::
+searchSolveStep()
+{
+  CNURIKABE_TRACE(TRACE, "searchSolveStep");
+
+  markProfile();
+
+  ProfileTimer timer(this, stats_.searchTime);
+
+  rebuild();
+
+  int numCells = getNumCells();
+
+  std::vector<int> solution, values;
+
+  long numNodes = 0;
+
+  int unitLit = -1;
+
+  SearchResult result = search(-1, solution, unitLit, numNodes);
+
+  if (result == SEARCH_SOLUTION) {
+    // cells which differ in two solutions can't be deduced
+    std::vector<char> ambiguous(numCells, 0);
+
+    CoordArray coords;
+
+    getFrontierCoords(coords);
+
+    for (std::size_t i = 0; i < coords.size(); ++i) {
+      int ind = coords[i].row*num_cols_ + coords[i].col;
+
+      if (ambiguous[ind]) continue;
+
+      CNurikabeImplications::Value value =
+        (solution[ind] == CNurikabeImplications::BLACK ?
+         CNurikabeImplications::WHITE : CNurikabeImplications::BLACK);
+
+      result = search(CNurikabeImplications::literal(ind, value), values, unitLit, numNodes);
+
+      if (result != SEARCH_SOLUTION)
+        break;
+
+      for (int j = 0; j < numCells; ++j)
+        if (values[j] != solution[j])
+          ambiguous[j] = 1;
+    }
+  }
+
+  if (result != SEARCH_UNIT)
+    return;
+
+  startChange();
+
+  Cell *cell = cells_[CNurikabeImplications::literalCell(unitLit)];
+
+  if (CNurikabeImplications::literalValue(unitLit) == CNurikabeImplications::BLACK)
+    cell->setBlack();
+  else
+    cell->setWhite();
+
+  endChange("search nogood");
+}
+
+// search for solution from top level board, first deciding start literal (if >= 0).
+// Returns solution (cell values), a learned top level literal or limit if out of
+// decisions (numNodes is updated)
+CNurikabe::Grid::SearchResult
+CNurikabe::Grid::
+search(int startLit, std::vector<int> &values, int &unitLit, long &numNodes)
+{
+  long maxNodes = nurikabe_->getMaxSearchNodes();
+
+  SearchResult result = SEARCH_LIMIT;
+
+  // decided literals per level
+  std::vector<int> decisions;
+
+  while (true) {
+    int lit = -1;
+
+    if (decisions.empty() && startLit >= 0)
+      lit = startLit;
+    else {
+      if (numNodes >= maxNodes) break;
+
+      CoordArray coords;
+
+      getFrontierCoords(coords);
+
+      if (coords.empty()) {
+        CellArray::const_iterator pc1, pc2;
+
+        for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+          if ((*pc1)->isUnknown()) {
+            coords.push_back((*pc1)->getCoord());
+            break;
+          }
+        }
+      }
+
+      // propagation checked no unknowns is a solution
+      if (coords.empty()) {
+        getLiteralValues(values);
+
+        result = SEARCH_SOLUTION;
+
+        break;
+      }
+
+      lit = CNurikabeImplications::literal(coords[0].row*num_cols_ + coords[0].col,
+                                           CNurikabeImplications::BLACK);
+    }
+
+    ++numNodes;
+
+    ++stats_.numSearchNodes;
 
-void
-CNurikabe::
-generate(int rows, int cols)
-{
-  delete grid_;
+    updateBreak();
 
-  grid_ = new Grid(this, rows, cols);
+    decisions.push_back(lit);
 
-  grid_->generate();
-}
+    Coords blackCoords, whiteCoords;
 
-//-------------
+    Cell *cell = cells_[CNurikabeImplications::literalCell(lit)];
 
-CNurikabe::Grid::
-Grid(CNurikabe *nurikabe, int num_rows, int num_cols) :
- nurikabe_(nurikabe), num_rows_(num_rows), num_cols_(num_cols), max_value_(1),
- changed_(true), changing_(0), maxRemaining_(8), maxSolutions_(4096),
- numIncomplete_(INT_MAX)
-{
-  cells_.resize(num_rows_*num_cols_);
+    if (CNurikabeImplications::literalValue(lit) == CNurikabeImplications::BLACK)
+      blackCoords.insert(cell->getCoord());
+    else
+      whiteCoords.insert(cell->getCoord());
 
-  for (int i = 0, r = 0; r < num_rows_; ++r)
-    for (int c = 0; c < num_cols_; ++c, ++i)
-      cells_[i] = new Cell(this, Cell::UNKNOWN, Coord(r, c));
-}
+    pushCoords(blackCoords, whiteCoords);
 
-void
-CNurikabe::Grid::
-reset()
-{
-  CellArray::iterator pc1, pc2;
+    while (! searchPropagate()) {
+      ++stats_.numConflicts;
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+      // remove failed level (a contradiction can't be rebuilt)
+      std::vector<int> failedDecisions = decisions;
 
-    cell->reset();
-  }
+      int numDecisions = decisions.size();
 
-  //------
+      popCoords();
 
-  Pools::const_iterator pp1, pp2;
+      decisions.pop_back();
 
-  for (pp1 = pools_.begin(), pp2 = pools_.end(); pp1 != pp2; ++pp1)
-    deletePool(*pp1);
+      // drop decisions before the last one not needed for contradiction, latest
+      // first until one is needed (each dropped decision is a level jumped back over)
+      std::vector<int> levels;
 
-  pools_.clear();
+      for (int i = 0; i < numDecisions; ++i)
+        levels.push_back(i);
 
-  //------
+      // the failed board also has cells asserted after earlier back jumps, so the
+      // decisions alone only give a sound nogood once checked (isConflict)
+      bool checked = false;
 
-  Islands::const_iterator pi1, pi2;
+      for (int i = numDecisions - 2; i >= 0; --i) {
+        std::vector<int> lits;
 
-  for (pi1 = islands_.begin(), pi2 = islands_.end(); pi1 != pi2; ++pi1)
-    deleteIsland(*pi1);
+        for (std::size_t j = 0; j < levels.size(); ++j)
+          if (levels[j] != i)
+            lits.push_back(failedDecisions[levels[j]]);
 
-  islands_.clear();
+        if (! isConflict(lits))
+          break;
 
-  //------
+        levels.erase(levels.begin() + i);
 
-  Gaps::const_iterator pg1, pg2;
+        checked = true;
+      }
 
-  for (pg1 = gaps_.begin(), pg2 = gaps_.end(); pg1 != pg2; ++pg1)
-    deleteGap(*pg1);
+      if (! checked)
+        checked = isConflict(failedDecisions);
 
-  gaps_.clear();
+      // learn nogood (clause of negated decisions)
+      CNurikabeNogoods::Clause clause;
 
-  //------
+      for (std::size_t i = 0; i < levels.size(); ++i)
+        clause.push_back(CNurikabeImplications::negate(failedDecisions[levels[i]]));
 
-  blackCoords_.clear();
-  whiteCoords_.clear();
+      if (checked) {
+        if (nogoods_.addClause(clause))
+          ++stats_.numLearned;
 
-  coordsStack_.clear();
+        if (clause.size() == 2)
+          implications_.addClause(clause[0], clause[1]);
+      }
 
-  maxRemaining_ = 8;
-  maxSolutions_ = 16;
+      // back jump to level of second deepest decision and assert negation of deepest
+      int assertLit = clause.back();
+      int level     = (levels.size() > 1 ? levels[levels.size() - 2] + 1 : 0);
 
-  addRegions();
+      if (level < numDecisions - 1)
+        ++stats_.numBackjumps;
 
-  rebuild();
-}
+      while (int(decisions.size()) > level) {
+        popCoords();
 
-void
-CNurikabe::Grid::
-addRegions()
-{
-  Regions::const_iterator pr1, pr2;
+        decisions.pop_back();
+      }
 
-  for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1)
-    delete *pr1;
+      rebuild(true);
 
-  regions_.clear();
+      // unchecked negation is only a search step, so can't be set on the board
+      if (level == 0) {
+        if (! checked)
+          return SEARCH_LIMIT;
 
-  CellArray::iterator pc1, pc2;
+        unitLit = assertLit;
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+        return SEARCH_UNIT;
+      }
 
-    if (! cell->isNumber()) continue;
+      Cell *cell1 = cells_[CNurikabeImplications::literalCell(assertLit)];
 
-    Region *region = new Region(this, cell);
+      if (CNurikabeImplications::literalValue(assertLit) == CNurikabeImplications::BLACK)
+        addBlackCoord(cell1->getCoord());
+      else
+        addWhiteCoord(cell1->getCoord());
+    }
+  }
 
-    regions_.insert(region);
+  while (! decisions.empty()) {
+    popCoords();
+
+    decisions.pop_back();
   }
 
-  setChanged();
+  rebuild(true);
+
+  return result;
 }
 
-CNurikabe::Pool *
+// check if literals fail from top level board (current search overlays are kept but
+// not rebuilt)
+bool
 CNurikabe::Grid::
-createPool()
+isConflict(const std::vector<int> &lits)
 {
-  Pool *pool;
+  CoordsStack coordsStack;
+  CountsStack countsStack;
+  Coords      blackCoords, whiteCoords;
+  CellCounts  counts = counts_;
 
-  if (poolsArray_.empty())
-    pool = new Pool(this);
-  else {
-    pool = poolsArray_.back();
+  std::swap(coordsStack, coordsStack_);
+  std::swap(countsStack, countsStack_);
+  std::swap(blackCoords, blackCoords_);
+  std::swap(whiteCoords, whiteCoords_);
 
-    poolsArray_.pop_back();
+  if (! countsStack.empty())
+    counts_ = countsStack.front();
 
-    pool->reset();
+  Coords blackCoords1, whiteCoords1;
+
+  for (std::size_t i = 0; i < lits.size(); ++i) {
+    const Coord &coord = cells_[CNurikabeImplications::literalCell(lits[i])]->getCoord();
+
+    if (CNurikabeImplications::literalValue(lits[i]) == CNurikabeImplications::BLACK)
+      blackCoords1.insert(coord);
+    else
+      whiteCoords1.insert(coord);
   }
 
-  pools_.insert(pool);
+  pushCoords(blackCoords1, whiteCoords1);
 
-  return pool;
-}
+  bool conflict = ! searchPropagate();
 
-void
-CNurikabe::Grid::
-deletePool(Pool *pool)
-{
-  pool->reset();
+  popCoords();
 
-  poolsArray_.push_back(pool);
+  std::swap(coordsStack, coordsStack_);
+  std::swap(countsStack, countsStack_);
+  std::swap(blackCoords, blackCoords_);
+  std::swap(whiteCoords, whiteCoords_);
 
-  pools_.erase(pool);
+  counts_ = counts;
+
+  resetColorBits();
+
+  return conflict;
 }
 
-CNurikabe::Island *
+// apply simple rules to search overlay, false if contradiction
+bool
 CNurikabe::Grid::
-createIsland()
+searchPropagate()
 {
-  Island *island;
-
-  if (islandsArray_.empty())
-    island = new Island(this);
-  else {
-    island = islandsArray_.back();
+  bool valid = true;
 
-    islandsArray_.pop_back();
+  try {
+    rebuild(true);
 
-    island->reset();
+    valid = checkValid();
+  }
+  catch (breakSignal &) {
+    throw;
+  }
+  catch (...) {
+    valid = false;
   }
 
-  islands_.insert(island);
+  // no unknowns must be solution
+  if (valid && getNumUnknown() == 0 && ! isSolved())
+    valid = false;
 
-  return island;
+  return valid;
 }
 
-void
+// raise limits hit by last recurse step (returns false if none hit)
+bool
 CNurikabe::Grid::
-deleteIsland(Island *island)
+escalateLimits()
 {
-  island->reset();
+  if (nextMaxRemaining_ <= maxRemaining_ && ! nextMaxSolutions_)
+    return false;
 
-  if (islands_.find(island) != islands_.end()) {
-    islandsArray_.push_back(island);
+  int maxEscalations = nurikabe_->getMaxEscalations();
 
-    islands_.erase(island);
-  }
-}
+  if (maxEscalations >= 0 && numEscalations_ >= maxEscalations)
+    return false;
 
-CNurikabe::Gap *
-CNurikabe::Grid::
-createGap()
-{
-  Gap *gap;
+  if (nextMaxRemaining_ > maxRemaining_) {
+    maxRemaining_     = nextMaxRemaining_;
+    nextMaxRemaining_ = -1;
 
-  if (gapsArray_.empty())
-    gap = new Gap(this);
-  else {
-    gap = gapsArray_.back();
+    CNURIKABE_TRACE(INFO, "escalate", "maxRemaining", maxRemaining_);
+  }
 
-    gapsArray_.pop_back();
+  if (nextMaxSolutions_) {
+    maxSolutions_     *= 2;
+    nextMaxSolutions_  = false;
 
-    gap->reset();
+    CNURIKABE_TRACE(INFO, "escalate", "maxSolutions", maxSolutions_);
   }
 
-  gaps_.insert(gap);
+  ++numEscalations_;
 
-  return gap;
+  return true;
 }
 
 void
 CNurikabe::Grid::
-deleteGap(Gap *gap)
+simpleSolveStep()
 {
-  gap->reset();
+  CNURIKABE_TRACE(TRACE, "simpleSolveStep");
 
-  if (gaps_.find(gap) != gaps_.end()) {
-    gapsArray_.push_back(gap);
+  markProfile();
 
-    gaps_.erase(gap);
+  rebuild();
+
+  // Solve Local 3x3 Patterns
+  solveLocal();
+
+  // Solve Regions
+  Regions::iterator pr1, pr2;
+
+  for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1) {
+    Region *region = *pr1;
+
+    region->solve();
   }
-}
 
-const CNurikabe::Cell *
-CNurikabe::Grid::
-getCell(const Coord &coord) const
-{
-  return cells_[coord.row*num_cols_ + coord.col];
-}
+  // Solve Pools
+  Pools::const_iterator pp1, pp2;
 
-CNurikabe::Cell *
-CNurikabe::Grid::
-getCell(const Coord &coord)
-{
-  return cells_[coord.row*num_cols_ + coord.col];
-}
+  for (pp1 = pools_.begin(), pp2 = pools_.end(); pp1 != pp2; ++pp1) {
+    Pool *pool = *pp1;
 
-void
-CNurikabe::Grid::
-setChanged(bool changed)
-{
-  changed_ = changed;
+    pool->solve();
+  }
 
-  if (changed && getCoordDepth() == 0) {
-    Regions::iterator pr1, pr2;
+  // Solve Islands
+  Islands::const_iterator pi1, pi2;
 
-    for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1) {
-      Region *region = *pr1;
+  for (pi1 = islands_.begin(), pi2 = islands_.end(); pi1 != pi2; ++pi1) {
+    Island *island = *pi1;
 
-      region->setChanged();
-    }
+    island->solve();
   }
-}
 
-void
-CNurikabe::Grid::
-pushCoords(const Coords &blackCoords, const Coords &whiteCoords)
-{
-  coordsStack_.push_back(CoordsPair(blackCoords_, whiteCoords_));
+  // Solve Gaps
+  Gaps::const_iterator pg1, pg2;
+
+  for (pg1 = gaps_.begin(), pg2 = gaps_.end(); pg1 != pg2; ++pg1) {
+    Gap *gap = *pg1;
+
+    gap->solve();
+  }
+
+  // Solve Wall Articulation Points
+  solveArticulation();
+
+  // Solve Cell Counts
+  solveCounts();
+
+  // Solve Implications
+  solveImplications();
+
+  // Learned nogoods
+  solveNogoods();
 
-  blackCoords_.insert(blackCoords.begin(), blackCoords.end());
-  whiteCoords_.insert(whiteCoords.begin(), whiteCoords.end());
+  //----
+
+  if (! checkSinglePool())
+    logicAssert(this, false, "multiple pools");
 }
 
+// Set unknown cells forced by their 3x3 neighbourhood (black L shape corner, enclosed by
+// white or black) using the precomputed pattern table and check known cells.
 void
 CNurikabe::Grid::
-popCoords()
+solveLocal()
 {
-  if (! coordsStack_.empty()) {
-    CoordsPair coordsPair = coordsStack_.back();
+  startChange();
 
-    coordsStack_.pop_back();
+  // a black cell enclosed by white is only valid as the board's single black cell
+  bool multiBlack = (getTargetBlack() > 1);
 
-    blackCoords_ = coordsPair.first;
-    whiteCoords_ = coordsPair.second;
-  }
-  else {
-    blackCoords_.clear();
-    whiteCoords_.clear();
+  CellArray::iterator pc1, pc2;
+
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
+
+    int flags = CNurikabePatterns::getFlags(getPattern(cell));
+
+    if (! flags) continue;
+
+    if      (cell->isUnknown()) {
+      bool notBlack = ((flags & CNurikabePatterns::NOT_BLACK) ||
+                       (multiBlack && (flags & CNurikabePatterns::ISOLATED_BLACK)));
+      bool notWhite = (flags & CNurikabePatterns::NOT_WHITE);
+
+      if (! notBlack && ! notWhite) continue;
+
+      logicAssert(this, ! notBlack || ! notWhite, "unknown can't be black or white");
+
+      if (notBlack)
+        cell->setWhite();
+      else
+        cell->setBlack();
+    }
+    else if (cell->isBlack())
+      logicAssert(this, ! (flags & CNurikabePatterns::NOT_BLACK), "black 2x2 block");
+    else if (! cell->isNumber(1))
+      logicAssert(this, ! (flags & CNurikabePatterns::NOT_WHITE), "white surrounded");
   }
+
+  endChange("local pattern");
 }
 
-void
+// encode states of cell's eight neighbours for pattern table lookup
+int
 CNurikabe::Grid::
-resetCoords()
+getPattern(const Cell *cell) const
 {
-  resetChange();
+  const Cell *cells[8] = {
+    cell->getNW(), cell->getN(), cell->getNE(),
+    cell->getW (),               cell->getE (),
+    cell->getSW(), cell->getS(), cell->getSE()
+  };
+
+  int pattern = 0;
 
-  blackCoords_.clear();
-  whiteCoords_.clear();
+  for (int i = 0; i < 8; ++i) {
+    CNurikabePatterns::State state;
 
-  coordsStack_.clear();
+    if      (! cells[i])
+      state = CNurikabePatterns::EDGE;
+    else if (cells[i]->isBlack())
+      state = CNurikabePatterns::BLACK;
+    else if (cells[i]->isNumberOrWhite())
+      state = CNurikabePatterns::WHITE;
+    else
+      state = CNurikabePatterns::UNKNOWN;
 
-  rebuild(true);
+    pattern = CNurikabePatterns::addState(pattern, CNurikabePatterns::Dir(i), state);
+  }
+
+  return pattern;
 }
 
+// The solved board has fixed black and white totals (white is the sum of the clues).
+// If either total is reached all unknown cells must be the other color.
 void
 CNurikabe::Grid::
-commit()
+solveCounts()
 {
-  try {
-    Coords blackCoords = blackCoords_;
-    Coords whiteCoords = whiteCoords_;
+  logicAssert(this, checkCounts(), "too many black or white cells");
 
-    resetCoords();
+  if (getNumUnknown() == 0) return;
 
-    startChange();
+  bool blackDone = (getNumBlack() == getTargetBlack());
+  bool whiteDone = (getNumWhite() == getTargetWhite());
 
-    Coords::const_iterator pc1, pc2;
+  if (! blackDone && ! whiteDone) return;
 
-    for (pc1 = blackCoords.begin(), pc2 = blackCoords.end(); pc1 != pc2; ++pc1) {
-      Cell *cell = getCell(*pc1);
+  startChange();
 
-      cell->setBlack();
-    }
+  CellArray::iterator pc1, pc2;
 
-    for (pc1 = whiteCoords.begin(), pc2 = whiteCoords.end(); pc1 != pc2; ++pc1) {
-      Cell *cell = getCell(*pc1);
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
 
-      cell->setWhite();
-    }
+    if (! cell->isUnknown()) continue;
 
-    endChange("commit");
-  }
-  catch (...) {
+    if (blackDone)
+      cell->setWhite();
+    else
+      cell->setBlack();
   }
+
+  endChange(blackDone ? "black count complete" : "white count complete");
 }
 
-void
+// check totals don't exceed solved totals
+bool
 CNurikabe::Grid::
-addBlackCoord(const Coord &coord)
+checkCounts() const
 {
-  blackCoords_.insert(coord);
-
-  setChanged();
+  return (getNumBlack() <= getTargetBlack() && getNumWhite() <= getTargetWhite());
 }
 
+// Set black any unknown cell which is an articulation point of the graph of black and
+// unknown cells and separates black cells (making it white would split the wall).
+// Uses an iterative Tarjan lowlink DFS so is O(cells).
 void
 CNurikabe::Grid::
-addWhiteCoord(const Coord &coord)
+solveArticulation()
 {
-  whiteCoords_.insert(coord);
+  int numCells = getNumCells();
 
-  setChanged();
-}
+  std::vector<int> disc  (numCells, 0); // discovery order (0 if not visited)
+  std::vector<int> low   (numCells, 0); // lowest discovery order reachable from subtree
+  std::vector<int> black (numCells, 0); // black cells in DFS subtree
+  std::vector<int> parent(numCells, -1);
+  std::vector<int> dir   (numCells, 0); // next neighbour to visit
 
-void
-CNurikabe::Grid::
-rebuild(bool force)
-{
-  if (changed_ || force) {
-    CellArray::iterator pc1, pc2;
+  std::vector<int> stack;
 
-    for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-      Cell *cell = *pc1;
+  // (cell, black cells in a subtree it separates) for current component
+  std::vector<std::pair<int, int>> cuts;
 
-      cell->resetPointers();
+  int order = 0;
+
+  for (int root = 0; root < numCells; ++root) {
+    if (disc[root] || ! cells_[root]->isUnknownOrBlack()) continue;
+
+    cuts.clear();
+
+    disc [root] = low[root] = ++order;
+    black[root] = cells_[root]->isBlack();
+
+    stack.push_back(root);
+
+    while (! stack.empty()) {
+      int ind = stack.back();
+
+      if (dir[ind] < 4) {
+        int d = dir[ind]++;
+
+        int r = ind / num_cols_, c = ind % num_cols_;
+
+        int ind1 = -1;
+
+        if      (d == 0) { if (r > 0             ) ind1 = ind - num_cols_; }
+        else if (d == 1) { if (r < num_rows_ - 1) ind1 = ind + num_cols_; }
+        else if (d == 2) { if (c > 0             ) ind1 = ind - 1; }
+        else             { if (c < num_cols_ - 1) ind1 = ind + 1; }
+
+        if (ind1 < 0 || ind1 == parent[ind] || ! cells_[ind1]->isUnknownOrBlack())
+          continue;
+
+        if (disc[ind1])
+          low[ind] = std::min(low[ind], disc[ind1]);
+        else {
+          disc  [ind1] = low[ind1] = ++order;
+          black [ind1] = cells_[ind1]->isBlack();
+          parent[ind1] = ind;
+
+          stack.push_back(ind1);
+        }
+
+        continue;
+      }
+
+      stack.pop_back();
+
+      int pind = parent[ind];
+
+      if (pind < 0) continue;
+
+      low  [pind] = std::min(low[pind], low[ind]);
+      black[pind] += black[ind];
+
+      // subtree of ind only connects to the rest of the component through parent
+      if (low[ind] >= disc[pind] && black[ind] > 0 && cells_[pind]->isUnknown())
+        cuts.push_back(std::make_pair(pind, black[ind]));
     }
 
-    buildRegions();
-    buildPools();
-    buildIslands();
-    buildGaps();
+    // parent needed if black cells on both sides
+    int numBlack = black[root];
 
-    changed_ = false;
+    startChange();
+
+    for (std::size_t i = 0; i < cuts.size(); ++i) {
+      if (numBlack - cuts[i].second > 0)
+        cells_[cuts[i].first]->setBlack();
+    }
+
+    endChange("black articulation point");
   }
 }
 
-void
+bool
 CNurikabe::Grid::
-buildRegions()
+checkSinglePool()
 {
-  numIncomplete_ = 0;
+  // Check if single pool if all unknowns are black
+  const ColorBits &bits = getColorBits();
 
-  // build regions for number cells
-  CellArray::iterator pc1, pc2;
+  CNurikabeBitBoard &black = workBits1_;
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+  black = bits.black;
 
-    if (! cell->isNumber()) continue;
+  Gaps::const_iterator pg1, pg2;
 
-    Region *region = cell->getRegion();
+  for (pg1 = gaps_.begin(), pg2 = gaps_.end(); pg1 != pg2; ++pg1) {
+    Gap *gap = *pg1;
 
-    region->build();
+    Coords::const_iterator pc1, pc2;
 
-    if (region->isComplete())
-      ++numIncomplete_;
+    for (pc1 = gap->getCoords().begin(), pc2 = gap->getCoords().end(); pc1 != pc2; ++pc1) {
+      int i = pc1->row*num_cols_ + pc1->col;
+
+      if (bits.unknown.test(i))
+        black.set(i);
+    }
   }
+
+  return bitKernels_.isConnected(black);
 }
 
-void
+bool
 CNurikabe::Grid::
-buildIslands()
+checkSinglePool(const Coords &icoords)
 {
-  // delete existing islands
-  Islands::iterator pi1, pi2;
-
-  for (pi1 = islands_.begin(), pi2 = islands_.end(); pi1 != pi2; ++pi1) {
-    Island *island = *pi1;
-
-    island->reset();
-
-    islandsArray_.push_back(island);
-  }
+  // Check if single pool if icoords are white and all other unknowns are black
+  const ColorBits &bits = getColorBits();
 
-  islands_.clear();
+  CNurikabeBitBoard &black = workBits1_, &unknown = workBits2_;
 
-  // build islands for isolated white cells
-  CellArray::iterator pc1, pc2;
+  black   = bits.black;
+  unknown = bits.unknown;
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+  Coords::const_iterator pc1, pc2;
 
-    if (! cell->isWhite()) continue;
+  for (pc1 = icoords.begin(), pc2 = icoords.end(); pc1 != pc2; ++pc1)
+    unknown.reset(pc1->row*num_cols_ + pc1->col);
 
-    if (cell->inRegion() || cell->inIsland()) continue;
+  black |= unknown;
 
-    cell->buildIsland();
-  }
+  return bitKernels_.isConnected(black);
 }
 
 void
 CNurikabe::Grid::
-buildPools()
+recurseSolveStep()
 {
-  // delete existing pools
-  Pools::iterator pp1, pp2;
+  CNURIKABE_TRACE(TRACE, "recurseSolveStep");
 
-  for (pp1 = pools_.begin(), pp2 = pools_.end(); pp1 != pp2; ++pp1) {
-    Pool *pool = *pp1;
+  markProfile();
 
-    pool->reset();
+  rebuild();
 
-    poolsArray_.push_back(pool);
-  }
+  // build region solutions (slow)
+  solutionRegions_.clear();
+  solutionsArray_ .clear();
 
-  pools_.clear();
+  solutionsComplete_ = true;
 
-  // clear pool pointers
-  CellArray::iterator pc1, pc2;
+  Coords allCoords;
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+  Regions::iterator pr1, pr2;
 
-    cell->resetPoolPointer();
-  }
+  for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1) {
+    Region *region = *pr1;
 
-  // build pools for black cells
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+    int remaining = region->getValue() - region->size();
 
-    if (! cell->isBlack()) continue;
+    if (remaining > getMaxRemaining()) {
+      CNURIKABE_TRACE(DEBUG, "too many remaining", "region", region->getValue(),
+                      "remaining", remaining);
+      updateMaxRemaining(remaining);
+      solutionsComplete_ = false; continue;
+    }
 
-    if (cell->inPool()) continue;
+    Solutions solutions;
 
-    cell->buildPool();
+    if (! region->buildSolutionsWithAllCoords(solutions, allCoords)) {
+      solutionsComplete_ = false;
+      continue;
+    }
+
+    if (remaining > 0) {
+      region->checkSolutions(solutions);
+
+      solutionRegions_.push_back(region);
+      solutionsArray_ .push_back(std::move(solutions));
+    }
   }
+
+  //----
+
+  // check any unused cells in all valid solutions
+  if (solutionsComplete_)
+    solveUnusedCells(allCoords);
+
+  validate();
 }
 
+// remove candidates of the last recurse step incompatible with all candidates of a
+// neighbouring region and use the reduced sets. Only run when limits can't be raised
+// (the board is unchanged since the recurse step) as it rarely forces a cell
 void
 CNurikabe::Grid::
-buildGaps()
+pruneSolveStep()
 {
-  // delete existing gaps
-  Gaps::iterator pg1, pg2;
-
-  for (pg1 = gaps_.begin(), pg2 = gaps_.end(); pg1 != pg2; ++pg1) {
-    Gap *gap = *pg1;
-
-    gap->reset();
+  CNURIKABE_TRACE(TRACE, "pruneSolveStep");
 
-    gapsArray_.push_back(gap);
-  }
-
-  gaps_.clear();
+  markProfile();
 
-  //------
+  if (! pruneSolutions(solutionRegions_, solutionsArray_))
+    return;
 
-  // build gaps for unknown cells
-  CellArray::iterator pc1, pc2;
+  for (std::size_t i = 0; i < solutionRegions_.size(); ++i)
+    solutionRegions_[i]->checkSolutions(solutionsArray_[i], "region arc consistency");
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+  if (solutionsComplete_) {
+    Coords allCoords;
 
-    if (! cell->isUnknown()) continue;
+    for (std::size_t i = 0; i < solutionsArray_.size(); ++i) {
+      Solutions::const_iterator ps1, ps2;
 
-    if (cell->inGap()) continue;
+      for (ps1 = solutionsArray_[i].begin(), ps2 = solutionsArray_[i].end(); ps1 != ps2; ++ps1)
+        allCoords.insert((*ps1).icoords.begin(), (*ps1).icoords.end());
+    }
 
-    cell->buildGap();
+    solveUnusedCells(allCoords);
   }
+
+  validate();
 }
 
-bool
+// unknown cells not used by any solution of any region (all regions enumerated) are black
+void
 CNurikabe::Grid::
-isSolved() const
+solveUnusedCells(const Coords &allCoords)
 {
-  // all regions must be complete
-  const Regions &regions = getRegions();
+  if (int(allCoords.size()) >= getNumCells())
+    return;
 
-  Regions::const_iterator pr1, pr2;
+  CellArray::iterator pc1, pc2;
 
-  for (pr1 = regions.begin(), pr2 = regions.end(); pr1 != pr2; ++pr1) {
-    Region *region = *pr1;
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
 
-    if (! region->isComplete())
-      return false;
-  }
+    if (allCoords.find(cell->getCoord()) != allCoords.end()) continue;
 
-  // single black pool
-  if (getNumPools() != 1)
-    return false;
+    if (! cell->isUnknown()) continue;
 
-  // no isolated whites
-  if (getNumIslands() != 0)
-    return false;
+    startChange();
 
-  // no gaps
-  if (getNumGaps() != 0)
-    return false;
+    cell->setBlack();
 
-  return true;
+    endChange("unused cells");
+  }
 }
 
+// AC-3 over candidate solutions of regions whose solutions can reach the same cells.
+// Solutions a (region A) and b (region B) are incompatible if their region cells
+// overlap or one forces black a cell the other forces white (region cells, their
+// black border and checkValid deductions). Returns true if any solution removed.
 bool
 CNurikabe::Grid::
-checkValid()
+pruneSolutions(const std::vector<Region *> &regions, std::vector<Solutions> &solutionsArray)
 {
-  // do as many simple steps as we can
-  for (;;) {
-    try {
-      simpleSolveStep();
-      break; // no change so we are done
-    }
-    catch (changedSignal &) {
-      resetChange();
-    }
-    catch (breakSignal &) {
-      resetCoords();
-      break_signal();
-    }
-    catch (...) {
-      resetChange();
-      return false;
-    }
-  }
-
-  updateBreak();
-
-  //------
-
-  // validate new board
+  int nr = regions.size();
 
-  rebuild();
+  if (nr < 2) return false;
 
-  //------
+  int numCells = getNumCells();
 
-  const Pools &pools = getPools();
+  // candidate boards (region cells, black, white) in pruneBits_, reused between calls
+  std::vector<int> offsets(nr + 1, 0);
 
-  Pools::const_iterator pp1, pp2;
+  for (int r = 0; r < nr; ++r)
+    offsets[r + 1] = offsets[r] + solutionsArray[r].size();
 
-  for (pp1 = pools.begin(), pp2 = pools.end(); pp1 != pp2; ++pp1) {
-    Pool *pool = *pp1;
+  int ns = offsets[nr];
 
-    if (! pool->isValid())
-      return false;
-  }
+  if (int(pruneBits_.size()) < 3*ns)
+    pruneBits_.resize(3*ns);
 
-  //------
+  if (int(pruneReach_.size()) < nr)
+    pruneReach_.resize(nr);
 
-  const Regions &regions = getRegions();
+  auto toBits = [&](const Coords &coords, CNurikabeBitBoard &bits) {
+    Coords::const_iterator pc1, pc2;
 
-  Regions::const_iterator pr1, pr2;
+    for (pc1 = coords.begin(), pc2 = coords.end(); pc1 != pc2; ++pc1)
+      bits.set((*pc1).row*num_cols_ + (*pc1).col);
+  };
 
-  for (pr1 = regions.begin(), pr2 = regions.end(); pr1 != pr2; ++pr1) {
-    Region *region = *pr1;
+  std::vector<const Solution *> candidates(ns);
+  std::vector<char>             alive     (ns, 1);
 
-    if (! region->isValid())
-      return false;
-  }
+  CNurikabeBitBoard &ocoords = workBits1_;
 
-  //------
+  for (int r = 0; r < nr; ++r) {
+    CNurikabeBitBoard &reach = pruneReach_[r]; // cells used by any solution of region
 
-  const Islands &islands = getIslands();
+    reach.resize(numCells);
 
-  Islands::const_iterator pi1, pi2;
+    int i = offsets[r];
 
-  for (pi1 = islands.begin(), pi2 = islands.end(); pi1 != pi2; ++pi1) {
-    Island *island = *pi1;
+    Solutions::const_iterator ps1, ps2;
 
-    if (! island->isValid())
-      return false;
-  }
+    for (ps1 = solutionsArray[r].begin(), ps2 = solutionsArray[r].end(); ps1 != ps2; ++ps1, ++i) {
+      candidates[i] = &(*ps1);
 
-  //------
+      CNurikabeBitBoard &icoords = pruneBits_[3*i    ];
+      CNurikabeBitBoard &black   = pruneBits_[3*i + 1];
+      CNurikabeBitBoard &white   = pruneBits_[3*i + 2];
 
-  const Gaps &gaps = getGaps();
+      icoords.resize(numCells); black.resize(numCells); white.resize(numCells);
+      ocoords.clear();
 
-  Gaps::const_iterator pg1, pg2;
+      toBits((*ps1).icoords    , icoords);
+      toBits((*ps1).blackCoords, black  );
+      toBits((*ps1).whiteCoords, white  );
+      toBits((*ps1).ocoords    , ocoords);
 
-  for (pg1 = gaps.begin(), pg2 = gaps.end(); pg1 != pg2; ++pg1) {
-    Gap *gap = *pg1;
+      // region cells are white and their border black
+      black |= ocoords;
+      white |= icoords;
 
-    if (! gap->isValid())
-      return false;
+      reach |= icoords;
+      reach |= ocoords;
+    }
   }
 
-  //------
+  auto compatible = [&](int i1, int i2) {
+    const CNurikabeBitBoard *a = &pruneBits_[3*i1], *b = &pruneBits_[3*i2];
 
-  if (isSolved()) {
-    //std::cout << "Final Solution" << std::endl;
+    return (! a[0].intersects(b[0]) &&
+            ! a[1].intersects(b[2]) &&
+            ! a[2].intersects(b[1]));
+  };
 
-    // ensure blacks make single pool
-    if (getNumPools() > 1)
-      return false;
-  }
+  // neighbouring regions
+  std::vector<std::vector<int>> neighbours(nr);
 
-  //------
+  for (int r1 = 0; r1 < nr; ++r1)
+    for (int r2 = r1 + 1; r2 < nr; ++r2)
+      if (pruneReach_[r1].intersects(pruneReach_[r2])) {
+        neighbours[r1].push_back(r2);
+        neighbours[r2].push_back(r1);
+      }
 
-  // got here so valid
+  // queue of arcs (r1, r2): remove solutions of r1 with no compatible solution in r2
+  std::vector<std::pair<int,int>> arcs;
+  std::vector<std::vector<char>>  queued(nr, std::vector<char>(nr, 0));
 
-  return true;
-}
+  for (int r1 = 0; r1 < nr; ++r1)
+    for (std::size_t j = 0; j < neighbours[r1].size(); ++j) {
+      arcs.push_back(std::pair<int,int>(r1, neighbours[r1][j]));
 
-void
-CNurikabe::Grid::
-solveStep()
-{
-  log("solveStep");
+      queued[r1][neighbours[r1][j]] = 1;
+    }
 
-  nextMaxRemaining_ = -1;
-  nextMaxSolutions_ = false;
+  bool pruned = false;
 
-  simpleSolveStep();
+  for (std::size_t k = 0; k < arcs.size(); ++k) {
+    int r1 = arcs[k].first;
+    int r2 = arcs[k].second;
 
-  recurseSolveStep();
+    queued[r1][r2] = 0;
 
-  // if got here then no change
+    updateBreak();
 
-  // try uping max remaining and max solutions
-  while (nextMaxRemaining_ > maxRemaining_ || nextMaxSolutions_) {
-    if (nextMaxRemaining_ > maxRemaining_) {
-      maxRemaining_     = nextMaxRemaining_;
-      nextMaxRemaining_ = -1;
+    bool changed = false;
 
-      log("Up max remaining limit to " + intToString(maxRemaining_));
-    }
+    for (int i1 = offsets[r1]; i1 < offsets[r1 + 1]; ++i1) {
+      if (! alive[i1]) continue;
 
-    if (nextMaxSolutions_) {
-      maxSolutions_     *= 2;
-      nextMaxSolutions_  = false;
+      bool supported = false;
 
-      log("Up max solutions limit to " + intToString(maxSolutions_));
-    }
+      for (int i2 = offsets[r2]; ! supported && i2 < offsets[r2 + 1]; ++i2)
+        supported = (alive[i2] && compatible(i1, i2));
 
-    //------
+      if (! supported) {
+        alive[i1] = 0;
 
-    simpleSolveStep();
+        changed = true;
+      }
+    }
 
-    recurseSolveStep();
-  }
-}
+    if (! changed) continue;
 
-void
-CNurikabe::Grid::
-simpleSolveStep()
-{
-  log("simpleSolveStep");
+    pruned = true;
 
-  rebuild();
+    for (std::size_t j = 0; j < neighbours[r1].size(); ++j) {
+      int r3 = neighbours[r1][j];
 
-  // Solve Regions
-  Regions::iterator pr1, pr2;
+      if (r3 == r2 || queued[r3][r1]) continue;
 
-  for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1) {
-    Region *region = *pr1;
+      arcs.push_back(std::pair<int,int>(r3, r1));
 
-    region->solve();
+      queued[r3][r1] = 1;
+    }
   }
 
-  // Solve Pools
-  Pools::const_iterator pp1, pp2;
+  if (! pruned) return false;
 
-  for (pp1 = pools_.begin(), pp2 = pools_.end(); pp1 != pp2; ++pp1) {
-    Pool *pool = *pp1;
+  for (int r = 0; r < nr; ++r) {
+    Solutions solutions;
 
-    pool->solve();
-  }
+    for (int i = offsets[r]; i < offsets[r + 1]; ++i)
+      if (alive[i])
+        solutions.insert(*candidates[i]);
 
-  // Solve Islands
-  Islands::const_iterator pi1, pi2;
+    CNURIKABE_TRACE(DEBUG, "arc consistent solutions", "value", regions[r]->getValue(),
+                    "count", solutions.size(), "was", solutionsArray[r].size());
 
-  for (pi1 = islands_.begin(), pi2 = islands_.end(); pi1 != pi2; ++pi1) {
-    Island *island = *pi1;
+    if (regions[r]->hasValidSolution() &&
+        solutions.find(regions[r]->getSolution()) == solutions.end())
+      logicError("arc consistency removed valid solution for " +
+                 intToString(regions[r]->getValue()));
 
-    island->solve();
+    solutionsArray[r] = solutions;
   }
 
-  // Solve Gaps
-  Gaps::const_iterator pg1, pg2;
+  return true;
+}
 
-  for (pg1 = gaps_.begin(), pg2 = gaps_.end(); pg1 != pg2; ++pg1) {
-    Gap *gap = *pg1;
+void
+CNurikabe::Grid::
+solveUnknown(Cell *cell)
+{
+  if (cell->isBlackRegionConstraint()) {
+    startChange();
 
-    gap->solve();
+    cell->setBlack();
+
+    endChange("black region constraint");
   }
 
-  //----
+  // (unknown surrounded by white or black is a local pattern)
 
-  if (! checkSinglePool())
-    logicAssert(this, false, "multiple pools");
+  // check for unreachables
+  if (! isBlackReachable(cell)) {
+    startChange();
+
+    cell->setWhite();
+
+    endChange("black unreachable");
+  }
 }
 
-bool
+void
 CNurikabe::Grid::
-checkSinglePool()
+setConstraints()
 {
-  // Check if single pool if all unknowns are black
-  Coords icoords, ocoords;
+  CoordsArray coordsArray;
 
-  Gaps::const_iterator pg1, pg2;
+  getOneWhiteCoords(coordsArray);
 
-  for (pg1 = gaps_.begin(), pg2 = gaps_.end(); pg1 != pg2; ++pg1) {
-    Gap *gap = *pg1;
+  CoordsArray::const_iterator pa1, pa2;
 
-    ocoords.insert(gap->getCoords().begin(), gap->getCoords().end());
-  }
+  for (pa1 = coordsArray.begin(), pa2 = coordsArray.end(); pa1 != pa2; ++pa1)
+    addOneWhiteConstraint(*pa1);
 
-  pushCoords(ocoords, icoords);
+  coordsArray.clear();
 
-  bool single = false;
-  bool first  = true;
+  getOneBlackCoords(coordsArray);
 
-  Cells blackCells;
+  for (pa1 = coordsArray.begin(), pa2 = coordsArray.end(); pa1 != pa2; ++pa1)
+    addOneBlackConstraint(*pa1);
 
-  CellArray::const_iterator pc1, pc2;
+  Islands::const_iterator pi1, pi2;
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+  for (pi1 = islands_.begin(), pi2 = islands_.end(); pi1 != pi2; ++pi1) {
+    Island *island = *pi1;
 
-    if (! cell->isBlack()) continue;
+    Region *region = island->getRegionConstraint();
 
-    if (first) {
-      addConnectedBlack(cell, blackCells);
-      first  = false;
-      single = true;
-    }
-    else {
-      if (blackCells.find(cell) == blackCells.end()) {
-        single = false;
-        break;
-      }
-    }
+    if (region)
+      region->addOneWhiteConstraint(island->getCoords());
   }
-
-  popCoords();
-
-  return single;
 }
 
-bool
+// unknown cells of 2x2 blocks with no white (one must be white)
+void
 CNurikabe::Grid::
-checkSinglePool(const Coords &icoords)
+getOneWhiteCoords(CoordsArray &coordsArray)
 {
-  Coords ocoords;
-
-  CellArray::const_iterator pc1, pc2;
+  CellArray::iterator pc1, pc2;
 
   for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
     Cell *cell = *pc1;
 
-    if (! cell->isUnknown()) continue;
+    if (cell->isNumberOrWhite()) continue;
 
-    const Coord &coord = cell->getCoord();
+    Cell *cellS  = cell->getS ();
+    Cell *cellE  = cell->getE ();
+    Cell *cellSE = cell->getSE();
 
-    if (icoords.find(coord) == icoords.end())
-      ocoords.insert(coord);
-  }
+    if (! cellS || ! cellE) continue;
 
-  pushCoords(ocoords, icoords);
+    if (cellS ->isNumberOrWhite()) continue;
+    if (cellE ->isNumberOrWhite()) continue;
+    if (cellSE->isNumberOrWhite()) continue;
 
-  bool single = false;
-  bool first  = true;
+    Coords unknownCoords;
 
-  Cells blackCells;
+    if (cell  ->isUnknown()) unknownCoords.insert(cell  ->getCoord());
+    if (cellS ->isUnknown()) unknownCoords.insert(cellS ->getCoord());
+    if (cellE ->isUnknown()) unknownCoords.insert(cellE ->getCoord());
+    if (cellSE->isUnknown()) unknownCoords.insert(cellSE->getCoord());
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+    coordsArray.push_back(unknownCoords);
+  }
+}
 
-    if (! cell->isBlack()) continue;
+// unknown cells outside each pool (one must be black if pool not complete wall)
+void
+CNurikabe::Grid::
+getOneBlackCoords(CoordsArray &coordsArray)
+{
+  Pools::const_iterator pp1, pp2;
 
-    if (first) {
-      addConnectedBlack(cell, blackCells);
-      first  = false;
-      single = true;
-    }
-    else {
-      if (blackCells.find(cell) == blackCells.end()) {
-        single = false;
-        break;
-      }
-    }
-  }
+  for (pp1 = pools_.begin(), pp2 = pools_.end(); pp1 != pp2; ++pp1) {
+    Pool *pool = *pp1;
 
-  popCoords();
+    Coords ocoords;
+
+    getOutsideUnknown(pool->getCoords(), ocoords);
 
-  return single;
+    coordsArray.push_back(ocoords);
+  }
 }
 
+// add two cell constraints of current board to implication graph. These stay valid
+// as the board is solved so are only added at the top level:
+//  . 2x2 block with two black cells: one of other two is white
+//  . pool (of several) with two exits: one is black
+//  . incomplete region or island with two exits: one is white
+//  . region needing one more cell: at most one exit is white
 void
 CNurikabe::Grid::
-recurseSolveStep()
+addImplications()
 {
-  log("recurseSolveStep");
+  if (! isTop()) return;
 
-  rebuild();
+  CoordsArray coordsArray;
 
-  // build region solutions (slow)
-  bool allValid = true;
+  getOneWhiteCoords(coordsArray);
 
-  Coords allCoords;
+  CoordsArray::const_iterator pa1, pa2;
 
-  Regions::iterator pr1, pr2;
+  for (pa1 = coordsArray.begin(), pa2 = coordsArray.end(); pa1 != pa2; ++pa1) {
+    if (pa1->size() == 2)
+      addImplication(*pa1->begin(), *pa1->rbegin(), CNurikabeImplications::WHITE);
+  }
 
-  for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1) {
-    Region *region = *pr1;
+  // pools must expand to join other pools
+  if (getNumPools() > 1) {
+    coordsArray.clear();
 
-    int remaining = region->getValue() - region->size();
+    getOneBlackCoords(coordsArray);
 
-    if (remaining > getMaxRemaining()) {
-      log("Too many remaining " + intToString(remaining));
-      updateMaxRemaining(remaining);
-      allValid = false; continue;
+    for (pa1 = coordsArray.begin(), pa2 = coordsArray.end(); pa1 != pa2; ++pa1) {
+      if (pa1->size() == 2)
+        addImplication(*pa1->begin(), *pa1->rbegin(), CNurikabeImplications::BLACK);
     }
+  }
 
-    Solutions solutions;
+  // incomplete regions must expand
+  Regions::const_iterator pr1, pr2;
 
-    if (! region->buildSolutionsWithAllCoords(solutions, allCoords)) {
-      allValid = false;
-      continue;
-    }
+  for (pr1 = regions_.begin(), pr2 = regions_.end(); pr1 != pr2; ++pr1) {
+    Region *region = *pr1;
 
-    if (remaining > 0)
-      region->checkSolutions(solutions);
-  }
+    if (region->isComplete()) continue;
 
-  //----
+    Coords ocoords;
 
-  // check any unused cells in all valid solutions
-  if (allValid && int(allCoords.size()) < getNumCells()) {
-    CellArray::iterator pc1, pc2;
+    getOutsideUnknown(region->getCoords(), ocoords);
 
-    for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-      Cell *cell = *pc1;
+    if (ocoords.size() == 2)
+      addImplication(*ocoords.begin(), *ocoords.rbegin(), CNurikabeImplications::WHITE);
 
-      if (allCoords.find(cell->getCoord()) != allCoords.end()) continue;
+    if (region->getValue() - region->size() != 1) continue;
 
-      if (! cell->isUnknown()) continue;
+    Coords::const_iterator pc1, pc2, pc3;
 
-      //std::cout << "Unused Cell: "; cell->getCoord().print(); std::cout << std::endl;
+    for (pc1 = ocoords.begin(), pc2 = ocoords.end(); pc1 != pc2; ++pc1)
+      for (pc3 = pc1, ++pc3; pc3 != pc2; ++pc3)
+        addImplication(*pc1, *pc3, CNurikabeImplications::BLACK);
+  }
 
-      startChange();
+  // islands must join a region
+  Islands::const_iterator pi1, pi2;
 
-      cell->setBlack();
+  for (pi1 = islands_.begin(), pi2 = islands_.end(); pi1 != pi2; ++pi1) {
+    Island *island = *pi1;
 
-      endChange("unused cells");
-    }
-  }
+    Coords ocoords;
 
-  validate();
+    getOutsideUnknown(island->getCoords(), ocoords);
+
+    if (ocoords.size() == 2)
+      addImplication(*ocoords.begin(), *ocoords.rbegin(), CNurikabeImplications::WHITE);
+  }
 }
 
+// add clause (coord1 is value or coord2 is value)
 void
 CNurikabe::Grid::
-solveUnknown(Cell *cell)
+addImplication(const Coord &coord1, const Coord &coord2, int value)
 {
-  if (cell->isBlackRegionConstraint()) {
-    startChange();
-
-    cell->setBlack();
-
-    endChange("black region constraint");
-  }
+  CNurikabeImplications::Value value1 = CNurikabeImplications::Value(value);
 
-  Cell *cellN = cell->getN();
-  Cell *cellS = cell->getS();
-  Cell *cellE = cell->getE();
-  Cell *cellW = cell->getW();
-
-  // if unknown surrounded by white, must be white
-  int numw = 0;
+  implications_.addClause(
+    CNurikabeImplications::literal(coord1.row*num_cols_ + coord1.col, value1),
+    CNurikabeImplications::literal(coord2.row*num_cols_ + coord2.col, value1));
+}
 
-  if (! cellN || cellN->isNumberOrWhite()) ++numw;
-  if (! cellS || cellS->isNumberOrWhite()) ++numw;
-  if (! cellE || cellE->isNumberOrWhite()) ++numw;
-  if (! cellW || cellW->isNumberOrWhite()) ++numw;
+// set cells forced by implication graph (unit propagation from known cells and
+// literals which imply their negation)
+void
+CNurikabe::Grid::
+solveImplications()
+{
+  addImplications();
 
-  if (numw == 4) {
-    startChange();
+  if (implications_.numClauses() == 0) return;
 
-    cell->setWhite();
+  std::vector<int> values;
 
-    endChange("unknown surrounded by white");
-  }
+  getLiteralValues(values);
 
-  // if unknown surrounded by black, must be black
-  int numb = 0;
+  std::vector<int> forced;
 
-  if (! cellN || cellN->isBlack()) ++numb;
-  if (! cellS || cellS->isBlack()) ++numb;
-  if (! cellE || cellE->isBlack()) ++numb;
-  if (! cellW || cellW->isBlack()) ++numb;
+  if (! implications_.solve(values, forced))
+    logicError("implication contradiction");
 
-  if (numb == 4) {
-    startChange();
+  startChange();
 
-    cell->setBlack();
+  for (std::size_t i = 0; i < forced.size(); ++i) {
+    Cell *cell = cells_[CNurikabeImplications::literalCell(forced[i])];
 
-    endChange("unknown surrounded by black");
+    if (CNurikabeImplications::literalValue(forced[i]) == CNurikabeImplications::BLACK)
+      cell->setBlack();
+    else
+      cell->setWhite();
   }
 
-  //------
-
-  // check for unreachables
-  if (! isBlackReachable(cell)) {
-    startChange();
-
-    cell->setWhite();
-
-    endChange("black unreachable");
-  }
+  endChange("implication");
 }
 
+// set cells forced by learned nogoods
 void
 CNurikabe::Grid::
-setConstraints()
+solveNogoods()
 {
-  CellArray::iterator pc1, pc2;
-
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
-
-    if (cell->isNumberOrWhite()) continue;
-
-    Cell *cellS  = cell->getS ();
-    Cell *cellE  = cell->getE ();
-    Cell *cellSE = cell->getSE();
-
-    if (cellS  && cellS ->isNumberOrWhite()) continue;
-    if (cellE  && cellE ->isNumberOrWhite()) continue;
-    if (cellSE && cellSE->isNumberOrWhite()) continue;
-
-    Cells unknownCells;
+  if (nogoods_.numClauses() == 0) return;
 
-    if (cell   && cell  ->isUnknown()) unknownCells.insert(cell);
-    if (cellS  && cellS ->isUnknown()) unknownCells.insert(cellS);
-    if (cellE  && cellE ->isUnknown()) unknownCells.insert(cellE);
-    if (cellSE && cellSE->isUnknown()) unknownCells.insert(cellSE);
+  std::vector<int> values;
 
-    addOneWhiteConstraint(unknownCells);
-  }
+  getLiteralValues(values);
 
-  Pools::const_iterator pp1, pp2;
+  std::vector<int> forced;
 
-  for (pp1 = pools_.begin(), pp2 = pools_.end(); pp1 != pp2; ++pp1) {
-    Pool *pool = *pp1;
+  if (! nogoods_.propagate(values, forced))
+    logicError("nogood contradiction");
 
-    Coords ocoords;
+  startChange();
 
-    getOutsideUnknown(pool->getCoords(), ocoords);
+  for (std::size_t i = 0; i < forced.size(); ++i) {
+    Cell *cell = cells_[CNurikabeImplications::literalCell(forced[i])];
 
-    addOneBlackConstraint(ocoords);
+    if (CNurikabeImplications::literalValue(forced[i]) == CNurikabeImplications::BLACK)
+      cell->setBlack();
+    else
+      cell->setWhite();
   }
 
-  Islands::const_iterator pi1, pi2;
+  endChange("learned nogood");
+}
 
-  for (pi1 = islands_.begin(), pi2 = islands_.end(); pi1 != pi2; ++pi1) {
-    Island *island = *pi1;
+// get cell values as implication literal values (BLACK, WHITE or UNKNOWN)
+void
+CNurikabe::Grid::
+getLiteralValues(std::vector<int> &values) const
+{
+  int numCells = getNumCells();
 
-    Region *region = island->getRegionConstraint();
+  values.resize(numCells);
 
-    if (region)
-      region->addOneWhiteConstraint(island->getCoords());
+  for (int i = 0; i < numCells; ++i) {
+    Cell *cell = cells_[i];
+
+    if      (cell->isBlack())
+      values[i] = CNurikabeImplications::BLACK;
+    else if (cell->isNumberOrWhite())
+      values[i] = CNurikabeImplications::WHITE;
+    else
+      values[i] = CNurikabeImplications::UNKNOWN;
   }
 }
 
@@ -1536,54 +3768,16 @@ isOtherPoolReachable(Cell *cell, const Pool *pool, const Coords &coords)
   return false;
 }
 
+// true if black cell next to cell or to unknown cells connected to it
 bool
 CNurikabe::Grid::
 isBlackReachable(Cell *cell)
 {
-  Coords coords;
-
-  return isBlackReachable(cell, coords);
-}
-
-bool
-CNurikabe::Grid::
-isBlackReachable(Cell *cell, const Coords &coords)
-{
-  if (coords.find(cell->getCoord()) != coords.end())
-    return false;
-
-  Cell *cellN = cell->getN();
-  Cell *cellS = cell->getS();
-  Cell *cellE = cell->getE();
-  Cell *cellW = cell->getW();
-
-  if (cellN && cellN->isBlack()) return true;
-  if (cellS && cellS->isBlack()) return true;
-  if (cellE && cellE->isBlack()) return true;
-  if (cellW && cellW->isBlack()) return true;
-
-  Coords coords1 = coords;
-
-  coords1.insert(cell->getCoord());
+  const ColorBits &bits = getColorBits();
 
-  if (cellN && cellN->isUnknown()) {
-    if (isBlackReachable(cellN, coords1))
-      return true;
-  }
-  if (cellS && cellS->isUnknown()) {
-    if (isBlackReachable(cellS, coords1))
-      return true;
-  }
-  if (cellE && cellE->isUnknown()) {
-    if (isBlackReachable(cellE, coords1))
-      return true;
-  }
-  if (cellW && cellW->isUnknown()) {
-    if (isBlackReachable(cellW, coords1))
-      return true;
-  }
+  const Coord &coord = cell->getCoord();
 
-  return false;
+  return bitKernels_.isReachable(coord.row*num_cols_ + coord.col, bits.unknown, bits.black);
 }
 
 bool
@@ -1836,89 +4030,70 @@ getOutsideUnknown(const Coords &icoords, Coords &ocoords)
 
 void
 CNurikabe::Grid::
-getOutsideUnknownOrWhite(const Coords &icoords, Coords &ocoords)
+validate()
 {
-  Coords::const_iterator pc1, pc2;
+  const ColorBits &bits = getColorBits();
 
-  for (pc1 = icoords.begin(), pc2 = icoords.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = getCell(*pc1);
+  CNurikabeBitBoard &t = workBits1_, &white = workBits2_;
 
-    Cell *cellN = cell->getN();
-    Cell *cellS = cell->getS();
-    Cell *cellE = cell->getE();
-    Cell *cellW = cell->getW();
+  // no pools allowed (2x2 all black) and black not surrounded by white
+  bitKernels_.blocks(bits.black, t);
 
-    // add touching unknowns not in inside set
-    if (cellN && cellN->isUnknownOrWhite() && icoords.find(cellN->getCoord()) == icoords.end())
-      ocoords.insert(cellN->getCoord());
-    if (cellS && cellS->isUnknownOrWhite() && icoords.find(cellS->getCoord()) == icoords.end())
-      ocoords.insert(cellS->getCoord());
-    if (cellE && cellE->isUnknownOrWhite() && icoords.find(cellE->getCoord()) == icoords.end())
-      ocoords.insert(cellE->getCoord());
-    if (cellW && cellW->isUnknownOrWhite() && icoords.find(cellW->getCoord()) == icoords.end())
-      ocoords.insert(cellW->getCoord());
-  }
-}
+  logicAssert(this, t.none(), "black pool or surrounded");
 
-void
-CNurikabe::Grid::
-validate()
-{
-  int num_unassigned = 0;
+  getIsolatedBlacks(t);
 
-  CellArray::iterator pc1, pc2;
+  logicAssert(this, t.none(), "black pool or surrounded");
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+  // white (not 1) not surrounded by black
+  white  = bits.white;
+  white |= bits.numbers;
 
-    Cell *cellN = cell->getN();
-    Cell *cellS = cell->getS();
-    Cell *cellE = cell->getE();
-    Cell *cellW = cell->getW();
+  bitKernels_.surrounded(bits.black, t);
 
-    if      (cell->isBlack()) {
-      // no pools allowed (2x2 all black)
-      Cell *cellSE = cell->getSE();
+  t &= white;
 
-      int n = 1;
+  for (int i = t.firstBit(); i >= 0; i = t.firstBit()) {
+    logicAssert(this, cells_[i]->isNumber(1), "white surrounded");
 
-      if (cellE  && cellE ->isBlack()) ++n;
-      if (cellS  && cellS ->isBlack()) ++n;
-      if (cellSE && cellSE->isBlack()) ++n;
+    t.reset(i);
+  }
 
-      logicAssert(this, n != 4, "black pool");
+  logicAssert(this, checkCounts(), "too many black or white cells");
 
-      // ensure not surrounded by white
-      n = 0;
+  // if no unknowns then single pool
 
-      if (! cellN || cellN->isWhite()) ++n;
-      if (! cellS || cellS->isWhite()) ++n;
-      if (! cellE || cellE->isWhite()) ++n;
-      if (! cellW || cellW->isWhite()) ++n;
+  // all regions are less than or equal to value and have single number square
+}
 
-      logicAssert(this, n != 4, "black surrounded");
-    }
-    else if (cell->isWhite()) {
-      // ensure not surrounded by black
-      if (! cell->isNumber(1)) {
-        int n = 0;
+// current black, white (not number), number and unknown cells as bitboards (cells
+// walked only if changed since last call)
+const CNurikabe::Grid::ColorBits &
+CNurikabe::Grid::
+getColorBits() const
+{
+  if (colorBitsValid_)
+    return colorBits_;
 
-        if (! cellN || cellN->isBlack()) ++n;
-        if (! cellS || cellS->isBlack()) ++n;
-        if (! cellE || cellE->isBlack()) ++n;
-        if (! cellW || cellW->isBlack()) ++n;
+  colorBits_.black  .clear();
+  colorBits_.white  .clear();
+  colorBits_.numbers.clear();
+  colorBits_.unknown.clear();
 
-        logicAssert(this, n != 4, "white surrounded");
-      }
-    }
-    else if (cell->isUnknown()) {
-      ++num_unassigned;
-    }
+  int n = cells_.size();
+
+  for (int i = 0; i < n; ++i) {
+    const Cell *cell = cells_[i];
+
+    if      (cell->isBlack ()) colorBits_.black  .set(i);
+    else if (cell->isWhite ()) colorBits_.white  .set(i);
+    else if (cell->isNumber()) colorBits_.numbers.set(i);
+    else                       colorBits_.unknown.set(i);
   }
 
-  // if no unknowns then single pool
+  colorBitsValid_ = true;
 
-  // all regions are less than or equal to value and have single number square
+  return colorBits_;
 }
 
 bool
@@ -2082,28 +4257,55 @@ endChange(const std::string &msg)
 
   --changing_;
 
-  updateBreak();
+  // time since last rule event is charged to this rule
+  if (changing_ == 0 && isProfiling()) {
+    TimePoint t = std::chrono::steady_clock::now();
 
-  if (changing_ == 0 && changed_) {
-    logNoNL(msg + " : ");
+    RuleStats &ruleStats = stats_.rules[msg];
 
-    int n = changes_.size();
+    ++ruleStats.numCalls;
 
-    for (int i = 0; i < n; ++i) {
-      if (i > 0) logNoNL(", ");
+    if (changed_) {
+      ++ruleStats.numFired;
 
-      logNoNL(toString(changes_[i]));
+      ruleStats.numCells += changes_.size();
     }
 
-    log("");
+    ruleStats.time += elapsedSecs(profileMark_, t);
 
-    changes_.clear();
+    profileMark_ = t;
+  }
+
+  if (changing_ == 0 && changed_) {
+    CNURIKABE_TRACE(DEBUG, "change", "rule", msg,
+                    "black", changedCoords(this, changes_, true),
+                    "white", changedCoords(this, changes_, false));
+
+    int n = changes_.size();
+
+    if (n > 0 && nurikabe_->getTraceWriter())
+      nurikabe_->getTraceWriter()->addStep(msg, changedCoords(this, changes_, true),
+                                           changedCoords(this, changes_, false));
 
     if (n > 0)
-      nurikabe_->notifyChanged();
+      nurikabe_->addChanges(changes_);
+
+    changes_.clear();
 
     changed_signal();
   }
+
+  // check break after changes are recorded so an interrupted solve does not lose
+  // cells already set at top level
+  updateBreak();
+}
+
+void
+CNurikabe::Grid::
+markProfile()
+{
+  if (isProfiling())
+    profileMark_ = std::chrono::steady_clock::now();
 }
 
 void
@@ -2122,13 +4324,6 @@ addChange(const Coord &coord)
   changes_.push_back(coord);
 }
 
-void
-CNurikabe::Grid::
-updateBreak() const
-{
-  nurikabe_->updateBreak();
-}
-
 void
 CNurikabe::Grid::
 generate()
@@ -2143,112 +4338,100 @@ generate()
   int num_rows = getNumRows();
   int num_cols = getNumCols();
 
-  int row = randInt(num_rows);
-  int col = randInt(num_cols);
+  // grow black wall from random cell. Each frontier cell touches the wall so the wall
+  // stays connected, and 2x2 blocks are checked incrementally as cells are added
+  CNurikabeWall wall(num_rows, num_cols);
 
-  Cell *startCell = getCell(Coord(row, col));
+  std::vector<char> queued(num_rows*num_cols, 0);
 
-  startCell->setValue(Cell::BLACK);
+  CellArray frontier;
 
-  CellArray blackCells;
+  auto addCell = [&](Cell *cell) {
+    const Coord &coord = cell->getCoord();
 
-  blackCells.push_back(startCell);
+    cell->setValue(Cell::BLACK);
 
-  int num_fails = 0;
+    wall.add(coord.row*num_cols + coord.col);
 
-  while (true) {
-    int n = blackCells.size();
+    Cell *cells[4] = { cell->getN(), cell->getS(), cell->getE(), cell->getW() };
 
-    Cells openCells;
+    for (int i = 0; i < 4; ++i) {
+      if (! cells[i]) continue;
 
-    // find next black expand cells
-    while (true) {
-      Cell *cell = blackCells[randInt(n)];
+      const Coord &coord1 = cells[i]->getCoord();
 
-      Cell *cellN = cell->getN();
-      Cell *cellS = cell->getS();
-      Cell *cellE = cell->getE();
-      Cell *cellW = cell->getW();
+      int ind1 = coord1.row*num_cols + coord1.col;
 
-      openCells.clear();
+      if (queued[ind1]) continue;
 
-      if (cellN && ! cellN->isBlack()) openCells.insert(cellN);
-      if (cellS && ! cellS->isBlack()) openCells.insert(cellS);
-      if (cellE && ! cellE->isBlack()) openCells.insert(cellE);
-      if (cellW && ! cellW->isBlack()) openCells.insert(cellW);
+      queued[ind1] = 1;
 
-      if (! openCells.empty())
-        break;
+      frontier.push_back(cells[i]);
     }
+  };
 
-    // chose valid expand cell
-    Cell *cell  = nullptr;
-    bool  found = false;
+  CNurikabeRand &rand = nurikabe_->getRand();
 
-    while (true) {
-      int n = openCells.size();
+  Cell *startCell = getCell(Coord(rand.randInt(num_rows), rand.randInt(num_cols)));
 
-      if (n == 0) break;
+  queued[startCell->getCoord().row*num_cols + startCell->getCoord().col] = 1;
 
-      cell = set_index<Cell *>(openCells, randInt(n));
+  addCell(startCell);
 
-      openCells.erase(cell);
+  // cells which would complete a 2x2 block can never become valid again (cells are
+  // only added) so are dropped from the frontier
+  while (! frontier.empty()) {
+    int i = rand.randInt(frontier.size());
 
-      cell->setValue(Cell::BLACK);
+    Cell *cell = frontier[i];
 
-      bool rc = checkBlacksValid();
+    frontier[i] = frontier.back();
 
-      if (rc) {
-        found = true;
-        break;
-      }
-
-      cell->setValue(Cell::UNKNOWN);
-
-      break;
-    }
+    frontier.pop_back();
 
-    // no expand cell so done
-    if (! found) {
-      ++num_fails;
-
-      if (num_fails > 100)
-        break;
+    const Coord &coord = cell->getCoord();
 
+    if (! wall.canAdd(coord.row*num_cols + coord.col))
       continue;
-    }
-
-    blackCells.push_back(cell);
 
-    num_fails = 0;
+    addCell(cell);
   }
 
-  // fill in numbers
-  Cells unknownCells;
+  logicAssert(this, wall.isConnected(), "generated wall not connected");
+
+  // fill in numbers (one per white area at random cell of area). Areas are flood
+  // filled in grid order so the numbered cell only depends on the seed
+  int max_value = 1;
+
+  CellArray area;
 
-  getUnknownCells(unknownCells);
+  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
+    Cell *cell = *pc1;
 
-  int n = unknownCells.size();
+    if (! cell->isUnknown())
+      continue;
 
-  while (n > 0) {
-    Cell *cell = set_index<Cell *>(unknownCells, randInt(n));
+    area.clear();
 
-    Cells cells;
+    area.push_back(cell);
 
-    addConnectedUnknown(cell, cells);
+    cell->setValue(Cell::WHITE);
 
-    Cells::iterator pc1, pc2;
+    for (std::size_t i = 0; i < area.size(); ++i) {
+      Cell *cells[4] = { area[i]->getN(), area[i]->getS(), area[i]->getE(), area[i]->getW() };
 
-    for (pc1 = cells.begin(), pc2 = cells.end(); pc1 != pc2; ++pc1)
-      (*pc1)->setValue(Cell::WHITE);
+      for (int j = 0; j < 4; ++j) {
+        if (! cells[j] || ! cells[j]->isUnknown()) continue;
 
-    cell->setValue(cells.size());
+        cells[j]->setValue(Cell::WHITE);
 
-    unknownCells.clear();
+        area.push_back(cells[j]);
+      }
+    }
 
-    getUnknownCells(unknownCells);
+    rand.pick(area)->setValue(area.size());
 
-    n = unknownCells.size();
+    max_value = std::max(max_value, int(area.size()));
   }
 
   for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
@@ -2258,6 +4441,8 @@ generate()
       cell->setValue(Cell::UNKNOWN);
   }
 
+  setMaxValue(max_value);
+
   addRegions();
 
   rebuild(true);
@@ -2283,28 +4468,42 @@ bool
 CNurikabe::Grid::
 checkBlacksValid()
 {
-  CellArray::iterator pc1, pc2;
+  const ColorBits &bits = getColorBits();
 
-  for (pc1 = cells_.begin(), pc2 = cells_.end(); pc1 != pc2; ++pc1) {
-    Cell *cell = *pc1;
+  CNurikabeBitBoard &t = workBits1_;
 
-    if (! cell->isBlack()) continue;
+  bitKernels_.blocks(bits.black, t);
 
-    Cell *cellS  = cell->getS ();
-    Cell *cellE  = cell->getE ();
-    Cell *cellSE = cell->getSE();
+  if (! t.none())
+    return false;
 
-    int n = 1;
+  getIsolatedBlacks(t);
 
-    if (cellE  && cellE ->isBlack()) ++n;
-    if (cellS  && cellS ->isBlack()) ++n;
-    if (cellSE && cellSE->isBlack()) ++n;
+  return t.none();
+}
 
-    if (n == 4)
-      return false;
+// black cells whose four neighbours are white (or number) or off board. These can't
+// join the wall so are only invalid when the solution has more than one black cell (none
+// returned otherwise)
+void
+CNurikabe::Grid::
+getIsolatedBlacks(CNurikabeBitBoard &res)
+{
+  if (getTargetBlack() <= 1) {
+    res.clear();
+    return;
   }
 
-  return true;
+  const ColorBits &bits = getColorBits();
+
+  CNurikabeBitBoard &white = workBits2_;
+
+  white  = bits.white;
+  white |= bits.numbers;
+
+  bitKernels_.surrounded(white, res);
+
+  res &= bits.black;
 }
 
 void
@@ -2412,7 +4611,7 @@ logicError(const std::string &msg)
   if (! isTop())
     throw std::logic_error(msg.c_str());
   else {
-    log("Logic Error: " + msg);
+    CNURIKABE_TRACE(ERROR, "logic error", "msg", msg);
     break_signal();
   }
 }
@@ -2440,6 +4639,7 @@ printMap(std::ostream &os) const
 
         if      (num < 10) os << num;
         else if (num < 36) os << char('A' + (num - 10));
+        else if (num < 62) os << char('a' + (num - 36));
         else               os << '?';
       }
       else if (cell->isWhite ()) os << ".";
@@ -2531,7 +4731,7 @@ void
 CNurikabe::Region::
 solve()
 {
-  log("region " + intToString(getValue()) + " " + cell_->getCoord().str() + " solve");
+  CNURIKABE_TRACE(TRACE, "region solve", "value", getValue(), "cell", cell_->getCoord());
 
   if (! isComplete()) {
     grid_->startChange();
@@ -2723,35 +4923,34 @@ void
 CNurikabe::Region::
 checkConnectCoords(Coords &coords)
 {
-  bool found = true;
+  // flood fill touching unknown or white cells which can be in region
+  std::vector<Coord> queue(coords.begin(), coords.end());
 
-  while (found) {
-    Coords ocoords;
+  while (! queue.empty()) {
+    Cell *cell = grid_->getCell(queue.back());
 
-    grid_->getOutsideUnknownOrWhite(coords, ocoords);
+    queue.pop_back();
 
-    found = false;
+    Cell *cells[4] = { cell->getN(), cell->getS(), cell->getE(), cell->getW() };
 
-    Coords::const_iterator pc1, pc2;
+    for (int i = 0; i < 4; ++i) {
+      Cell *cell1 = cells[i];
 
-    for (pc1 = ocoords.begin(), pc2 = ocoords.end(); pc1 != pc2; ++pc1) {
-      const Coord &coord = *pc1;
+      if (! cell1 || ! cell1->isUnknownOrWhite()) continue;
 
-      Cell *cell = grid_->getCell(coord);
+      if (coords.find(cell1->getCoord()) != coords.end()) continue;
 
-      if (! cell->canBeInRegion(this)) continue;
+      if (! cell1->canBeInRegion(this)) continue;
 
-      if (coords.find(coord) == coords.end()) {
-        coords.insert(*pc1);
+      coords.insert(cell1->getCoord());
 
-        found = true;
-      }
+      queue.push_back(cell1->getCoord());
     }
   }
 
   // ensure enough resources
-  logicAssert(grid_, int(coords.size()) >= getValue(),
-               "no room for region " + intToString(getValue()));
+  if (int(coords.size()) < getValue())
+    grid_->logicError("no room for region " + intToString(getValue()));
 
   // if only just enough then all must be white
   if (int(coords.size()) == getValue()) {
@@ -2797,13 +4996,15 @@ bool
 CNurikabe::Region::
 buildSolutionsWithAllCoords(Solutions &solutions, Coords &allCoords)
 {
+  ProfileTimer timer(grid_, grid_->getStats().solutionsTime);
+
   solutions.clear();
 
   solutionsMap_.clear();
 
   // build all possible solutions for this region
   if (! isComplete()) {
-    log("buildSolutions");
+    CNURIKABE_TRACE(TRACE, "buildSolutions", "value", getValue());
 
     if (! buildSolutions(solutions))
       return false;
@@ -2814,11 +5015,12 @@ buildSolutionsWithAllCoords(Solutions &solutions, Coords &allCoords)
       return false;
     }
 
-    logicAssert(grid_, ! solutions.empty(), "no solutions for " + intToString(getValue()));
+    if (solutions.empty())
+      grid_->logicError("no solutions for " + intToString(getValue()));
 
     //------
 
-    log(intToString(solutions.size()) + " solutions");
+    CNURIKABE_TRACE(DEBUG, "solutions", "value", getValue(), "count", solutions.size());
 
     // set outside coords
     Solutions::iterator ps1, ps2;
@@ -2847,7 +5049,7 @@ buildSolutionsWithAllCoords(Solutions &solutions, Coords &allCoords)
 
     solutions = solutions1;
 
-    log(intToString(solutions.size()) + " valid solutions");
+    CNURIKABE_TRACE(DEBUG, "valid solutions", "value", getValue(), "count", solutions.size());
 
     if (hasValidSolution() && solutions.find(solution_) == solutions.end()) {
       logicAssert(grid_, false, "Build Solutions has no Valid Solution Match");
@@ -2871,7 +5073,7 @@ buildSolutionsWithAllCoords(Solutions &solutions, Coords &allCoords)
 
     Coords commonIOCoords = grid_->getCommonCoords(ioCoordsArray);
 
-    log(intToString(commonIOCoords.size()) + " common coords");
+    CNURIKABE_TRACE(DEBUG, "common coords", "value", getValue(), "coords", commonIOCoords);
 
     Coords::const_iterator pc1, pc2;
 
@@ -2907,13 +5109,14 @@ hasValidSolution() const
 
 void
 CNurikabe::Region::
-checkSolutions(const Solutions &solutions)
+checkSolutions(const Solutions &solutions, const std::string &msg)
 {
   if (isComplete()) return;
 
-  logicAssert(grid_, ! solutions.empty(), "no valid solutions for " + intToString(getValue()));
+  if (solutions.empty())
+    grid_->logicError("no valid solutions for " + intToString(getValue()));
 
-  log(intToString(solutions.size()) + " solutions");
+  CNURIKABE_TRACE(DEBUG, "solutions", "value", getValue(), "count", solutions.size());
 
   CoordsArray whiteCoordsArray;
   CoordsArray blackCoordsArray;
@@ -2932,8 +5135,8 @@ checkSolutions(const Solutions &solutions)
   Coords commonICoords = grid_->getCommonCoords(whiteCoordsArray);
   Coords commonOCoords = grid_->getCommonCoords(blackCoordsArray);
 
-  log(intToString(commonICoords.size()) + " common white, " +
-      intToString(commonOCoords.size()) + " common black");
+  CNURIKABE_TRACE(DEBUG, "common solution coords", "value", getValue(),
+                  "white", commonICoords, "black", commonOCoords);
 
   Coords::const_iterator pc1, pc2;
 
@@ -2949,7 +5152,7 @@ checkSolutions(const Solutions &solutions)
     cell->setBlack();
   }
 
-  grid_->endChange("region common coords");
+  grid_->endChange(msg);
 
   //------
 
@@ -2980,6 +5183,8 @@ bool
 CNurikabe::Region::
 buildSolutions(Coords &coords, Solutions &solutions)
 {
+  ++grid_->getStats().numSolutionNodes;
+
   grid_->updateBreak();
 
   int nc = coords.size();
@@ -3019,7 +5224,7 @@ buildSolutions(Coords &coords, Solutions &solutions)
   Solutions &nSolutions = solutionsMap_[nc];
 
   if (nSolutions.find(solution) != nSolutions.end()) {
-    log("Skip already used solution for " + intToString(nc));
+    CNURIKABE_TRACE(TRACE, "skip used solution", "value", getValue(), "size", nc);
     return true;
   }
 
@@ -3035,8 +5240,10 @@ buildSolutions(Coords &coords, Solutions &solutions)
 
     solutions.insert(solution1);
 
+    ++grid_->getStats().numSolutions;
+
     if (int(solutions.size()) > grid_->getMaxSolutions()) {
-      log("Too many solutions for " + intToString(getValue()));
+      CNURIKABE_TRACE(DEBUG, "too many solutions", "value", getValue());
       grid_->updateMaxSolutions();
       return false;
     }
@@ -3184,7 +5391,7 @@ isValid() const
     Coords coords;
 
     if (! grid_->checkNonBlack(cell_, coords, getValue())) {
-      log("Not enough resources for region " + intToString(getValue()));
+      CNURIKABE_TRACE(DEBUG, "not enough resources", "value", getValue());
       return false;
     }
   }
@@ -3233,12 +5440,7 @@ filterWhiteCoords(Coords &unknownCoords)
     }
 
     if (found) {
-      logNoNL("force next coords:");
-
-      for (pc1 = constraint.coords.begin(), pc2 = constraint.coords.end(); pc1 != pc2; ++pc1)
-        logNoNL(" " + toString(*pc1));
-
-      log("");
+      CNURIKABE_TRACE(TRACE, "force next coords", "coords", constraint.coords);
 
       unknownCoords = constraint.coords;
 
@@ -3465,26 +5667,9 @@ void
 CNurikabe::Pool::
 solve()
 {
-  log("pool solve");
-
-  // check for black L shapes
-  grid_->startChange();
-
-  Coords::const_iterator p1, p2;
-
-  for (p1 = coords_.begin(), p2 = coords_.end(); p1 != p2; ++p1) {
-    Cell *cell = grid_->getCell(*p1);
-
-    // if L shape at this black cell then corner must be white
-    Cell *lcell = cell->getLShapeCornerCell();
+  CNURIKABE_TRACE(TRACE, "pool solve");
 
-    if (lcell)
-      lcell->setWhite();
-  }
-
-  grid_->endChange("black l shape");
-
-  //------
+  // (black L shape corner is a local pattern)
 
   // if more than 1 pool then set single expand point for this pool to black
   if (grid_->getNumPools() > 1) {
@@ -3515,44 +5700,12 @@ solve()
   }
 }
 
+// (2x2 blocks and black surrounded by white are checked for all pools at once by
+// Grid::checkBlacksValid)
 bool
 CNurikabe::Pool::
 isValid() const
 {
-  Coords::const_iterator p1, p2;
-
-  for (p1 = coords_.begin(), p2 = coords_.end(); p1 != p2; ++p1) {
-    Cell *cell = grid_->getCell(*p1);
-
-    Cell *cellS  = cell->getS ();
-    Cell *cellE  = cell->getE ();
-    Cell *cellSE = cell->getSE();
-
-    // ensure no black pool
-    int n = 1;
-
-    if (cellE  && cellE ->isBlack()) ++n;
-    if (cellS  && cellS ->isBlack()) ++n;
-    if (cellSE && cellSE->isBlack()) ++n;
-
-    if (n == 4)
-      return false;
-
-    Cell *cellN = cell->getN();
-    Cell *cellW = cell->getW();
-
-    // ensure not surrounded by white
-    n = 0;
-
-    if (! cellN || cellN->isWhite()) ++n;
-    if (! cellS || cellS->isWhite()) ++n;
-    if (! cellE || cellE->isWhite()) ++n;
-    if (! cellW || cellW->isWhite()) ++n;
-
-    if (n == 4)
-      return false;
-  }
-
   bool otherPools = (grid_->getNumPools() > 1);
 
   if (otherPools) {
@@ -3692,7 +5845,7 @@ void
 CNurikabe::Island::
 solve()
 {
-  log("island solve");
+  CNURIKABE_TRACE(TRACE, "island solve");
 
   Coords icoords = coords_;
   Coords ocoords;
@@ -3865,7 +6018,7 @@ void
 CNurikabe::Gap::
 solve()
 {
-  log("gap solve");
+  CNURIKABE_TRACE(TRACE, "gap solve");
 
   Coords ocoords;
 
@@ -3998,6 +6151,8 @@ init()
   pool_              = nullptr;
   island_            = nullptr;
   gap_               = nullptr;
+
+  grid_->resetColorBits();
 }
 
 int
@@ -4014,6 +6169,8 @@ charToValue(char c)
     return Cell::BLACK;
   else if (c >= 'A' && c <= 'Z')
     return c - 'A' + 10;
+  else if (c >= 'a' && c <= 'z')
+    return c - 'a' + 36;
   else {
     std::cerr << "Bad board character '" << c << "'" << std::endl;
     return Cell::UNKNOWN;
@@ -4026,6 +6183,8 @@ CNurikabe::Cell::
 setValue(int value)
 {
   value_ = value;
+
+  grid_->resetColorBits();
 }
 
 void
@@ -4125,6 +6284,8 @@ setWhite()
 
     value_ = WHITE;
 
+    grid_->addCount(WHITE);
+
     assert(grid_->inChange());
 
     grid_->setChanged();
@@ -4171,6 +6332,8 @@ setBlack()
 
     value_ = BLACK;
 
+    grid_->addCount(BLACK);
+
     assert(grid_->inChange());
 
     grid_->setChanged();
@@ -4211,6 +6374,19 @@ setRegionConstraint(Region *region)
     region_constraint_ = BLACK_REGION_CONSTRAINT;
 }
 
+// set region constraint to that of same cell in another grid (same puzzle)
+void
+CNurikabe::Cell::
+copyRegionConstraint(const Cell *cell)
+{
+  Region *region = cell->region_constraint_;
+
+  if (region && region != BLACK_REGION_CONSTRAINT)
+    region = grid_->getCell(region->getNumberCell()->getCoord())->getRegion();
+
+  region_constraint_ = region;
+}
+
 void
 CNurikabe::Cell::
 reset()
@@ -4246,59 +6422,6 @@ resetPoolPointer()
   pool_ = nullptr;
 }
 
-CNurikabe::Cell *
-CNurikabe::Cell::
-getLShapeCornerCell() const
-{
-  // check for black L shape
-  logicAssert(grid_, isBlack(), "l shape cell not black");
-
-  Cell *cellN = getN();
-  Cell *cellE = getE();
-
-  if (cellN && cellN->isBlack() && cellE && cellE->isBlack()) {
-    Cell *lcell = getNE();
-
-    logicAssert(grid_, ! lcell->isBlack(), "invalid black pool");
-
-    if (lcell->isUnknown())
-      return lcell;
-  }
-
-  Cell *cellW = getW();
-
-  if (cellN && cellN->isBlack() && cellW && cellW->isBlack()) {
-    Cell *lcell = getNW();
-
-    logicAssert(grid_, ! lcell->isBlack(), "invalid black pool");
-
-    if (lcell->isUnknown())
-      return lcell;
-  }
-
-  Cell *cellS = getS();
-
-  if (cellS && cellS->isBlack() && cellE && cellE->isBlack()) {
-    Cell *lcell = getSE();
-
-    logicAssert(grid_, ! lcell->isBlack(), "invalid black pool");
-
-    if (lcell->isUnknown())
-      return lcell;
-  }
-
-  if (cellS && cellS->isBlack() && cellW && cellW->isBlack()) {
-    Cell *lcell = getSW();
-
-    logicAssert(grid_, ! lcell->isBlack(), "invalid black pool");
-
-    if (lcell->isUnknown())
-      return lcell;
-  }
-
-  return nullptr;
-}
-
 CNurikabe::Pool *
 CNurikabe::Cell::
 getPool() const
@@ -1,15 +1,24 @@
 #ifndef CNurikabe_H
 #define CNurikabe_H
 
+#include <CNurikabeBitKernels.h>
+#include <CNurikabeImplications.h>
+#include <CNurikabeNogoods.h>
+#include <CNurikabeRand.h>
+
 #include <cstdlib>
 
 #include <vector>
 #include <set>
 #include <map>
+#include <string>
+#include <chrono>
 #include <iostream>
 
 #define BLACK_REGION_CONSTRAINT (reinterpret_cast<CNurikabe::Region *>(0x1))
 
+class CNurikabeTraceWriter;
+
 class CNurikabe {
  public:
   // coordinate (sorted by row then col)
@@ -88,6 +97,178 @@ class CNurikabe {
 
   typedef std::pair<Coords,Coords> CoordsPair;
 
+  // puzzle definition (row major cell values and optional solution values)
+  struct Puzzle {
+    int              rows { 0 };
+    int              cols { 0 };
+    std::vector<int> values;
+    std::vector<int> solution;
+    uint64_t         seed { 0 }; // generator seed (0 if not generated)
+
+    bool hasSolution() const { return ! solution.empty(); }
+  };
+
+  // largest board (rows*cols) read from a board file or corpus
+  enum { MAX_CELLS = 1<<22 };
+
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  // difficulty tier (most expensive rules needed for a deduction)
+  enum Tier {
+    TIER_NONE      = 0,
+    TIER_SIMPLE    = 1, // local rules (Grid::simpleSolveStep)
+    TIER_PROBE     = 2, // failed literal probing (Grid::probeSolveStep)
+    TIER_RECURSE   = 3, // region solution enumeration at initial limits
+    TIER_ESCALATED = 4, // enumeration after raising max remaining/max solutions
+    TIER_SEARCH    = 5, // cell search with learned nogoods (Grid::searchSolveStep)
+    NUM_TIERS      = 6
+  };
+
+  // difficulty grade
+  struct Grade {
+    bool   solved                { false };
+    Tier   tier                  { TIER_NONE }; // highest tier needed
+    int    numEscalations        { 0 };         // limit escalations needed
+    int    maxRemaining          { 0 };         // final limits
+    int    maxSolutions          { 0 };
+    int    numSteps[NUM_TIERS]   { };           // deductions per tier
+    long   work                  { 0 };         // Region::buildSolutions nodes
+    double score                 { 0.0 };
+  };
+
+  // per deduction rule profile (keyed by endChange message)
+  struct RuleStats {
+    long   numCalls { 0 };   // endChange calls
+    long   numFired { 0 };   // calls which changed the grid
+    long   numCells { 0 };   // grid cells deduced (top level only)
+    double time     { 0.0 }; // secs since previous rule event
+  };
+
+  typedef std::map<std::string, RuleStats> RuleStatsMap;
+
+  // solver work counters (counts always kept, times and rules only when profiling)
+  struct Stats {
+    long   numRebuilds      { 0 };   // grid rebuilds performed
+    long   numCheckValid    { 0 };   // Grid::checkValid calls
+    long   numSolutions     { 0 };   // candidate region solutions enumerated
+    long   numSolutionNodes { 0 };   // Region::buildSolutions recursion nodes
+    long   numPushCoords    { 0 };   // Grid::pushCoords calls
+    long   numPopCoords     { 0 };   // Grid::popCoords calls
+    long   numProbes        { 0 };   // failed literal probes (cell black or white)
+    long   numSearchNodes   { 0 };   // cell search decisions
+    long   numConflicts     { 0 };   // cell search contradictions
+    long   numLearned       { 0 };   // nogoods learned from contradictions
+    long   numBackjumps     { 0 };   // backtracks skipping more than one decision
+    double rebuildTime      { 0.0 }; // secs in rebuild
+    double checkValidTime   { 0.0 }; // secs in checkValid
+    double solutionsTime    { 0.0 }; // secs in Region::buildSolutions
+    double probeTime        { 0.0 }; // secs in Grid::probeSolveStep
+    double searchTime       { 0.0 }; // secs in Grid::searchSolveStep
+
+    RuleStatsMap rules;
+
+    void reset() { *this = Stats(); }
+
+    void print(std::ostream &os) const;
+
+    void printJson(std::ostream &os) const;
+  };
+
+  // optional solver callbacks (busy state, changed cells, interrupt). With no observer
+  // attached the solver makes no callbacks and skips the break checks
+  class Observer {
+   public:
+    virtual ~Observer() { }
+
+    virtual void setBusy(bool) { }
+
+    virtual void notifyChanged(const Coords &) { }
+
+    // return true to interrupt the solve
+    virtual bool checkBreak() { return false; }
+  };
+
+  // observer which interrupts the solve after a timeout (from start) and passes callbacks
+  // on to an optional chained observer
+  class TimeoutObserver : public Observer {
+   public:
+    TimeoutObserver(double timeout=0.0, Observer *observer=nullptr) :
+     observer_(observer), timeout_(timeout) {
+    }
+
+    double timeout() const { return timeout_; }
+    void setTimeout(double secs) { timeout_ = secs; }
+
+    void start() {
+      start_    = std::chrono::steady_clock::now();
+      timedOut_ = false;
+    }
+
+    double elapsed() const {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+    bool isTimedOut() const { return timedOut_; }
+
+    void setBusy(bool busy) override {
+      if (observer_) observer_->setBusy(busy);
+    }
+
+    void notifyChanged(const Coords &coords) override {
+      if (observer_) observer_->notifyChanged(coords);
+    }
+
+    bool checkBreak() override {
+      if (timeout_ > 0 && elapsed() > timeout_)
+        timedOut_ = true;
+
+      return (timedOut_ || (observer_ && observer_->checkBreak()));
+    }
+
+   private:
+    Observer  *observer_ { nullptr };
+    double     timeout_  { 0.0 };
+    TimePoint  start_;
+    bool       timedOut_ { false };
+  };
+
+  // solver stages to run (portfolio solving runs several in parallel)
+  struct Strategy {
+    std::string name;
+    bool        probe          { true };  // failed literal probing
+    bool        enumerate      { true };  // region solution enumeration and escalation
+    int         maxEscalations { -1 };    // max limit escalations (< 0 for no limit)
+    long        maxSearchNodes { 10000 }; // cell search decisions per step (0 for none)
+  };
+
+  typedef std::vector<Strategy> Strategies;
+
+  // options for library solve
+  struct SolveOptions {
+    double    timeout        { 0.0 };     // max secs (<= 0 for no limit)
+    int       maxEscalations { -1 };      // max limit escalations (< 0 for no limit)
+    int       probeThreads   { 1 };       // threads for failed literal probing
+    long      maxSearchNodes { 10000 };   // cell search decisions per step (0 for none)
+    bool      grade          { false };   // compute difficulty grade
+    bool      profile        { false };   // collect rule times in stats
+    Observer *observer       { nullptr }; // optional callbacks (not owned)
+
+    Strategies portfolio;           // strategies to run in parallel (empty for one solve)
+    bool       shareCells { true }; // portfolio strategies share deduced cells
+  };
+
+  // result of library solve
+  struct SolveResult {
+    bool             valid    { false }; // puzzle could be loaded
+    bool             solved   { false };
+    bool             timedOut { false };
+    std::vector<int> values;             // row major number, BLACK, WHITE or UNKNOWN
+    Grade            grade;              // if options grade
+    Stats            stats;
+    double           time     { 0.0 };   // solve secs
+    std::string      strategy;           // portfolio strategy which solved
+  };
+
   class Grid;
   class Region;
   class Pool;
@@ -131,6 +312,8 @@ class CNurikabe {
     void setValue(int value);
     void setSolution(int solution);
 
+    int getSolution() const { return solution_; }
+
     bool isUnknown() const;
     bool isWhite  () const;
     bool isBlack  () const;
@@ -152,8 +335,6 @@ class CNurikabe {
 
     bool isSolvedNumberOrWhite() const { return isNumber() || isSolvedWhite(); }
 
-    Cell *getLShapeCornerCell() const;
-
     //------
 
     void setRegion(Region *region);
@@ -188,6 +369,8 @@ class CNurikabe {
 
     void setRegionConstraint(Region *region);
 
+    void copyRegionConstraint(const Cell *cell);
+
     bool isBlackRegionConstraint() const {
       return (region_constraint_ == BLACK_REGION_CONSTRAINT);
     }
@@ -418,7 +601,8 @@ class CNurikabe {
 
     bool buildSolutions(Coords &coords, Solutions &solutions);
 
-    void checkSolutions(const Solutions &solutions);
+    void checkSolutions(const Solutions &solutions,
+                        const std::string &msg="region common coords");
 
     void build();
 
@@ -587,11 +771,22 @@ class CNurikabe {
    public:
     Grid(CNurikabe *nurikabe, int num_rows, int num_cols);
 
+   ~Grid();
+
     int getNumRows() const { return num_rows_; }
     int getNumCols() const { return num_cols_; }
 
     int getNumCells() const { return num_rows_*num_cols_; }
 
+    // current (including overlay) cell totals, updated as cells are set
+    int getNumBlack  () const { return counts_.numBlack; }
+    int getNumWhite  () const { return counts_.numWhite; }
+    int getNumUnknown() const { return counts_.numUnknown; }
+
+    // solved totals (white is sum of clues)
+    int getTargetBlack() const { return getNumCells() - clueSum_; }
+    int getTargetWhite() const { return clueSum_; }
+
     const Cell *getCell(const Coord &coord) const;
 
     Cell *getCell(const Coord &coord);
@@ -617,9 +812,19 @@ class CNurikabe {
       nextMaxSolutions_ = true;
     }
 
+    bool escalateLimits();
+
+    int getNumEscalations() const { return numEscalations_; }
+
+    Tier getStepTier() const { return stepTier_; }
+
     void setChanged(bool changed=true);
     bool isChanged() const { return changed_; }
 
+    const Stats &getStats() const { return stats_; }
+
+    Stats &getStats() { return stats_; }
+
     void pushCoords(const Coords &blackCoords, const Coords &whiteCoords);
     void popCoords();
 
@@ -634,6 +839,16 @@ class CNurikabe {
     void addBlackCoord(const Coord &coord);
     void addWhiteCoord(const Coord &coord);
 
+    // update totals for unknown cell set to value (BLACK or WHITE)
+    void addCount(int value) {
+      --counts_.numUnknown;
+
+      if (value == Cell::BLACK)
+        ++counts_.numBlack;
+      else
+        ++counts_.numWhite;
+    }
+
     bool isBlackCoord(const Coord &coord) const {
       return blackCoords_.find(coord) != blackCoords_.end();
     }
@@ -681,6 +896,49 @@ class CNurikabe {
     void simpleSolveStep();
     void recurseSolveStep();
 
+    void pruneSolveStep();
+
+    void solveUnusedCells(const Coords &allCoords);
+
+    void probeSolveStep();
+
+    bool probeCell(const Coord &coord, bool black);
+
+    bool syncProbeCopy(const Grid *grid);
+
+    void getFrontierCoords(CoordArray &coords) const;
+
+    void searchSolveStep();
+
+    // cell search result
+    enum SearchResult {
+      SEARCH_SOLUTION, // found solution
+      SEARCH_UNIT,     // learned top level cell value
+      SEARCH_LIMIT     // out of decisions
+    };
+
+    SearchResult search(int startLit, std::vector<int> &values, int &unitLit,
+                        long &numNodes);
+
+    bool isConflict(const std::vector<int> &lits);
+
+    bool searchPropagate();
+
+    bool pruneSolutions(const std::vector<Region *> &regions,
+                        std::vector<Solutions> &solutionsArray);
+
+    void solveLocal();
+
+    int getPattern(const Cell *cell) const;
+
+    void solveArticulation();
+
+    void solveCounts();
+
+    bool checkCounts() const;
+
+    void countCells();
+
     bool checkSinglePool();
     bool checkSinglePool(const Coords &coords);
 
@@ -688,10 +946,41 @@ class CNurikabe {
 
     void validate();
 
-    bool checkValid();
+    void getIsolatedBlacks(CNurikabeBitBoard &res);
+
+    // current cell colors as bitboards (bit row*cols + col)
+    struct ColorBits {
+      CNurikabeBitBoard black;
+      CNurikabeBitBoard white;   // not number
+      CNurikabeBitBoard numbers;
+      CNurikabeBitBoard unknown;
+    };
+
+    // cached until cells change (walked again on first use after a change)
+    const ColorBits &getColorBits() const;
+
+    void resetColorBits() { colorBitsValid_ = false; }
+
+    bool checkValid(int maxSteps=-1);
 
     void setConstraints();
 
+    void getOneWhiteCoords(CoordsArray &coordsArray);
+    void getOneBlackCoords(CoordsArray &coordsArray);
+
+    void addImplications();
+    void addImplication(const Coord &coord1, const Coord &coord2, int value);
+
+    void solveImplications();
+
+    void solveNogoods();
+
+    void getLiteralValues(std::vector<int> &values) const;
+
+    const CNurikabeImplications &getImplications() const { return implications_; }
+
+    const CNurikabeNogoods &getNogoods() const { return nogoods_; }
+
     void addOneWhiteConstraint(const Cells &cells);
     void addOneWhiteConstraint(const Coords &coords);
 
@@ -701,7 +990,6 @@ class CNurikabe {
     bool isOtherPoolReachable(Cell *cell, const Pool *pool, const Coords &coords);
 
     bool isBlackReachable(Cell *cell);
-    bool isBlackReachable(Cell *cell, const Coords &coords);
 
     bool canConnectToRegion(Cell *cell, Region *region) const;
     bool canConnectToRegion(Cell *cell, Region *region, Cells &cells) const;
@@ -718,8 +1006,6 @@ class CNurikabe {
 
     void getOutsideUnknown(const Coords &whiteCoords, Coords &unknownCoords);
 
-    void getOutsideUnknownOrWhite(const Coords &coords, Coords &unknownCoords);
-
     bool checkNonBlack(Cell *cell, Coords &coords, int maxNum);
 
     Coords getCommonCoords(const CoordsArray &coordsArray);
@@ -735,12 +1021,21 @@ class CNurikabe {
 
     void addChange(const Coord &coord);
 
-    void updateBreak() const;
+    // check for interrupt (only if an observer is attached)
+    void updateBreak() const {
+      if (nurikabe_->getObserver())
+        nurikabe_->updateBreak();
+    }
+
+    bool isProfiling() const { return nurikabe_->isProfiling(); }
+
+    void markProfile();
 
     void generate();
 
     void getUnknownCells(Cells &cells);
 
+    // no 2x2 black blocks and no black cell surrounded by white
     bool checkBlacksValid();
 
     void logicError(const std::string &msg);
@@ -753,7 +1048,15 @@ class CNurikabe {
     void printMap(std::ostream &os) const;
 
    private:
+    // black, white (including numbers) and unknown cell totals
+    struct CellCounts {
+      int numBlack   { 0 };
+      int numWhite   { 0 };
+      int numUnknown { 0 };
+    };
+
     typedef std::vector<CoordsPair> CoordsStack;
+    typedef std::vector<CellCounts> CountsStack;
     typedef std::vector<Pool *>     PoolArray;
     typedef std::vector<Island *>   IslandArray;
     typedef std::vector<Gap *>      GapArray;
@@ -776,15 +1079,34 @@ class CNurikabe {
     int           nextMaxRemaining_;
     int           maxSolutions_;
     bool          nextMaxSolutions_;
+    int           numEscalations_;
+    Tier          stepTier_;
     int           numIncomplete_;
     Coords        blackCoords_, whiteCoords_;
     CoordsStack   coordsStack_;
+    CellCounts    counts_;
+    CNurikabeImplications implications_; // top level binary cell constraints
+    CNurikabeNogoods      nogoods_;      // clauses learned by cell search
+    bool          probeIdle_ { false };   // last probe step found nothing
+    std::vector<CNurikabe *> probeCopies_; // board copy per probe thread (kept between steps)
+    CNurikabeBitKernels bitKernels_;     // 2x2/surround tests for board size
+    mutable ColorBits   colorBits_;      // cell colors (if colorBitsValid_)
+    mutable bool        colorBitsValid_ { false };
+    CNurikabeBitBoard   workBits1_, workBits2_; // check work boards (sized for board)
+    std::vector<Region *>  solutionRegions_;  // regions enumerated by last recurse step
+    std::vector<Solutions> solutionsArray_;   // and their candidate solutions
+    bool                   solutionsComplete_ { false }; // all regions enumerated
+    std::vector<CNurikabeBitBoard> pruneBits_, pruneReach_; // pruneSolutions work boards
+    CountsStack   countsStack_;
+    int           clueSum_ { 0 };
+    Stats         stats_;
+    TimePoint     profileMark_;
   };
 
  public:
   CNurikabe();
 
-  virtual ~CNurikabe() { }
+  virtual ~CNurikabe() { delete grid_; }
 
   int getNumRows() const;
   int getNumCols() const;
@@ -793,6 +1115,16 @@ class CNurikabe {
 
   bool init(const std::string &board_def, const std::string &solution_def);
 
+  bool init(const Puzzle &puzzle);
+
+  Puzzle getPuzzle() const;
+
+  bool load(std::istream &is);
+  bool loadFile(const std::string &filename);
+
+  void save(std::ostream &os) const;
+  bool saveFile(const std::string &filename) const;
+
   void reset();
 
   Grid *getGrid() const { return grid_; }
@@ -803,16 +1135,73 @@ class CNurikabe {
 
   void solve();
 
+  // solve puzzle on a private solver (no shared state)
+  static SolveResult solve(const Puzzle &puzzle, const SolveOptions &options);
+
   bool solveStep();
 
+  // solve recording the tier of each deduction and compute difficulty score
+  void grade(Grade &grade);
+
   bool isSolved() const;
 
+  bool isProfiling() const { return profiling_; }
+  void setProfiling(bool b) { profiling_ = b; }
+
+  // max limit escalations for board (< 0 for no limit)
+  int getMaxEscalations() const { return maxEscalations_; }
+  void setMaxEscalations(int n) { maxEscalations_ = n; }
+
+  // threads used to probe unknown cells (results don't depend on count)
+  int getProbeThreads() const { return probeThreads_; }
+  void setProbeThreads(int n) { probeThreads_ = std::max(n, 1); }
+
+  // max cell search decisions per step once enumeration is exhausted (0 for no search)
+  long getMaxSearchNodes() const { return maxSearchNodes_; }
+  void setMaxSearchNodes(long n) { maxSearchNodes_ = n; }
+
+  // run failed literal probing step
+  bool isProbing() const { return probing_; }
+  void setProbing(bool b) { probing_ = b; }
+
+  // run region solution enumeration (and escalation) steps
+  bool isEnumerating() const { return enumerating_; }
+  void setEnumerating(bool b) { enumerating_ = b; }
+
+  void setStrategy(const Strategy &strategy);
+
+  // deduction, enumeration and cell search strategies
+  static Strategies defaultPortfolio();
+
+  // solve with strategies on copies of board in parallel threads, at most one per core
+  // with the rest run in order as threads finish (first to solve wins and cancels the
+  // rest), deduced cells can be shared between strategies. Returns
+  // index of strategy which solved (-1 if none, deduced cells are still applied)
+  int solvePortfolio(const Strategies &strategies, bool shareCells=true);
+
+  // random number generator used by generate (per instance so reproducible from seed)
+  CNurikabeRand &getRand() { return rand_; }
+
+  void setSeed(uint64_t seed) { rand_.seed(seed); }
+
+  const Stats &getStats() const { return grid_->getStats(); }
+
+  void resetStats() { grid_->getStats().reset(); }
+
   CNurikabe::Solutions getRegionSolutions(Region *region, int maxDepth) const;
   CNurikabe::Solutions getRegionSolutions(Region *region) const;
 
   void setCellBlack(Cell *cell);
   void setCellWhite(Cell *cell);
 
+  // apply recorded deduction (see CNurikabeTrace)
+  bool applyStep(const std::string &rule, const CoordArray &blackCoords,
+                 const CoordArray &whiteCoords);
+
+  // record deductions to trace writer (not owned)
+  CNurikabeTraceWriter *getTraceWriter() const { return traceWriter_; }
+  void setTraceWriter(CNurikabeTraceWriter *writer) { traceWriter_ = writer; }
+
   void playSolution(const Solution &solution, bool validate=true);
 
   void unplaySolution();
@@ -829,17 +1218,47 @@ class CNurikabe {
 
   void print(std::ostream &os) const;
 
-  virtual void setBusy(bool) const { }
+  //------
+
+  // change notification throttling (changes are batched and delivered at most every
+  // interval msecs or when max changes are pending)
+  int getNotifyInterval() const { return notifyInterval_; }
+  void setNotifyInterval(int msecs) { notifyInterval_ = msecs; }
+
+  int getNotifyMaxChanges() const { return notifyMaxChanges_; }
+  void setNotifyMaxChanges(int n) { notifyMaxChanges_ = n; }
+
+  void addChanges(const CoordArray &changes);
+
+  void flushChanges();
+
+  //------
 
-  virtual void notifyChanged() { }
+  // solver callbacks (not owned)
+  Observer *getObserver() const { return observer_; }
+  void setObserver(Observer *observer) { observer_ = observer; }
 
-  virtual bool checkBreak() { return false; }
+  void setBusy(bool busy) const { if (observer_) observer_->setBusy(busy); }
 
  private:
   bool parse(const std::string &board_def, const std::string &solution_def);
 
  private:
-  Grid *grid_ { nullptr };
+  Grid          *grid_             { nullptr };
+  Coords         pendingChanges_;
+  int            notifyInterval_   { 100 };
+  int            notifyMaxChanges_ { 256 };
+  TimePoint      lastNotify_;
+  bool           profiling_        { false };
+  int            maxEscalations_   { -1 };
+  int            probeThreads_     { 1 };
+  long           maxSearchNodes_   { 10000 };
+  bool           probing_          { true };
+  bool           enumerating_      { true };
+  CNurikabeRand  rand_;
+  Observer      *observer_         { nullptr };
+
+  CNurikabeTraceWriter *traceWriter_ { nullptr };
 };
 
 #endif
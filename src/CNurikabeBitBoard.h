@@ -0,0 +1,165 @@
+#ifndef CNurikabeBitBoard_H
+#define CNurikabeBitBoard_H
+
+#include <vector>
+#include <cstdint>
+
+// Set of board cells as a bitset (bit row*cols + col)
+//
+// Used where the solver compares many cell sets (e.g. region candidate solutions) and
+// std::set<Coord> intersection would dominate. Shifts move every cell by a fixed offset
+// so neighbour tests over the whole board are a few word operations (see
+// CNurikabeBitKernels).
+class CNurikabeBitBoard {
+ public:
+  CNurikabeBitBoard(int numBits=0) {
+    resize(numBits);
+  }
+
+  void resize(int numBits) {
+    numBits_ = numBits;
+
+    words_.assign((numBits + 63)/64, 0);
+  }
+
+  int numBits() const { return numBits_; }
+
+  void clear() {
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      words_[i] = 0;
+  }
+
+  void set(int i) { words_[i >> 6] |= (uint64_t(1) << (i & 63)); }
+
+  void reset(int i) { words_[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+
+  bool test(int i) const { return (words_[i >> 6] >> (i & 63)) & 1; }
+
+  bool none() const {
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      if (words_[i]) return false;
+
+    return true;
+  }
+
+  int count() const {
+    int n = 0;
+
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      n += popCount(words_[i]);
+
+    return n;
+  }
+
+  // true if any cell in both sets (same size)
+  bool intersects(const CNurikabeBitBoard &b) const {
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      if (words_[i] & b.words_[i]) return true;
+
+    return false;
+  }
+
+  CNurikabeBitBoard &operator|=(const CNurikabeBitBoard &b) {
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      words_[i] |= b.words_[i];
+
+    return *this;
+  }
+
+  CNurikabeBitBoard &operator&=(const CNurikabeBitBoard &b) {
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      words_[i] &= b.words_[i];
+
+    return *this;
+  }
+
+  CNurikabeBitBoard &andNot(const CNurikabeBitBoard &b) {
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      words_[i] &= ~b.words_[i];
+
+    return *this;
+  }
+
+  // complement (bits past numBits stay clear)
+  void flip() {
+    for (std::size_t i = 0; i < words_.size(); ++i)
+      words_[i] = ~words_[i];
+
+    clearTail();
+  }
+
+  // set to b with bit i moved to bit i - n (i.e. b >> n), n >= 0
+  void assignShiftDown(const CNurikabeBitBoard &b, int n) {
+    int nw = int(words_.size());
+    int ws = n >> 6, bs = n & 63;
+
+    for (int i = 0; i < nw; ++i) {
+      uint64_t lo = (i + ws     < nw ? b.words_[i + ws    ] : 0);
+      uint64_t hi = (i + ws + 1 < nw ? b.words_[i + ws + 1] : 0);
+
+      words_[i] = (bs ? (lo >> bs) | (hi << (64 - bs)) : lo);
+    }
+  }
+
+  // set to b with bit i moved to bit i + n (i.e. b << n), n >= 0
+  void assignShiftUp(const CNurikabeBitBoard &b, int n) {
+    int nw = int(words_.size());
+    int ws = n >> 6, bs = n & 63;
+
+    for (int i = nw - 1; i >= 0; --i) {
+      uint64_t hi = (i - ws     >= 0 ? b.words_[i - ws    ] : 0);
+      uint64_t lo = (i - ws - 1 >= 0 ? b.words_[i - ws - 1] : 0);
+
+      words_[i] = (bs ? (hi << bs) | (lo >> (64 - bs)) : hi);
+    }
+
+    clearTail();
+  }
+
+  // index of lowest set bit (-1 if none)
+  int firstBit() const {
+    for (std::size_t i = 0; i < words_.size(); ++i) {
+      uint64_t w = words_[i];
+
+      if (! w) continue;
+
+      int n = 0;
+
+      for (; ! (w & 1); w >>= 1)
+        ++n;
+
+      return int(64*i) + n;
+    }
+
+    return -1;
+  }
+
+  friend bool operator==(const CNurikabeBitBoard &b1, const CNurikabeBitBoard &b2) {
+    return b1.words_ == b2.words_;
+  }
+
+  friend bool operator!=(const CNurikabeBitBoard &b1, const CNurikabeBitBoard &b2) {
+    return ! (b1 == b2);
+  }
+
+ private:
+  void clearTail() {
+    if (numBits_ & 63)
+      words_.back() &= (uint64_t(1) << (numBits_ & 63)) - 1;
+  }
+
+  static int popCount(uint64_t w) {
+    int n = 0;
+
+    for (; w; w &= w - 1)
+      ++n;
+
+    return n;
+  }
+
+ private:
+  int                   numBits_ { 0 };
+  std::vector<uint64_t> words_;
+};
+
+#endif
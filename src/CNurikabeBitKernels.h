@@ -0,0 +1,166 @@
+#ifndef CNurikabeBitKernels_H
+#define CNurikabeBitKernels_H
+
+#include <CNurikabeBitBoard.h>
+
+// Whole board 2x2, surround and connectivity tests on row major bitboards
+// (CNurikabeBitBoard).
+//
+// Neighbour tests shift the board by a cell offset (1 for east/west, cols for
+// north/south) and combine with word and/or, so each test is a few passes over
+// (rows*cols + 63)/64 words instead of a walk over every cell's neighbours. Shifted bits
+// wrap between rows so are masked (or, for off board neighbours, set) with the first/last
+// column. Connected cells are found by dilating a seed and masking until it stops
+// growing.
+//
+// Work boards are allocated by resize so the tests don't allocate (and one instance
+// can't be used by two threads).
+class CNurikabeBitKernels {
+ public:
+  CNurikabeBitKernels(int rows=0, int cols=0) {
+    resize(rows, cols);
+  }
+
+  void resize(int rows, int cols) {
+    rows_ = rows;
+    cols_ = cols;
+
+    int n = rows*cols;
+
+    firstCol_.resize(n); lastCol_.resize(n);
+    firstRow_.resize(n); lastRow_.resize(n);
+
+    for (int r = 0; r < rows; ++r) {
+      firstCol_.set(r*cols);
+      lastCol_ .set(r*cols + cols - 1);
+    }
+
+    for (int c = 0; c < cols; ++c) {
+      firstRow_.set(c);
+      lastRow_ .set((rows - 1)*cols + c);
+    }
+
+    t_.resize(n); d_.resize(n); s_.resize(n);
+  }
+
+  int rows() const { return rows_; }
+  int cols() const { return cols_; }
+
+  // top left cells of 2x2 blocks of cells all in b
+  void blocks(const CNurikabeBitBoard &b, CNurikabeBitBoard &res) const {
+    CNurikabeBitBoard &t = t_;
+
+    res = b;
+
+    t.assignShiftDown(b, 1        ); res &= t;
+    t.assignShiftDown(b, cols_    ); res &= t;
+    t.assignShiftDown(b, cols_ + 1); res &= t;
+
+    res.andNot(lastCol_);
+  }
+
+  // cells whose four neighbours are in b or off board
+  void surrounded(const CNurikabeBitBoard &b, CNurikabeBitBoard &res) const {
+    CNurikabeBitBoard &t = t_;
+
+    if (res.numBits() != b.numBits())
+      res.resize(b.numBits());
+
+    // north
+    res.assignShiftUp(b, cols_); res |= firstRow_;
+
+    // south
+    t.assignShiftDown(b, cols_); t |= lastRow_; res &= t;
+
+    // east
+    t.assignShiftDown(b, 1); t |= lastCol_; res &= t;
+
+    // west
+    t.assignShiftUp(b, 1); t |= firstCol_; res &= t;
+  }
+
+  // cells of b and their four neighbours
+  void dilate(const CNurikabeBitBoard &b, CNurikabeBitBoard &res) const {
+    CNurikabeBitBoard &t = t_;
+
+    res = b;
+
+    t.assignShiftUp  (b, cols_); res |= t;
+    t.assignShiftDown(b, cols_); res |= t;
+    t.assignShiftDown(b, 1    ); t.andNot(lastCol_ ); res |= t;
+    t.assignShiftUp  (b, 1    ); t.andNot(firstCol_); res |= t;
+  }
+
+  // add to seed the cells of mask connected to it
+  void fill(CNurikabeBitBoard &seed, const CNurikabeBitBoard &mask) const {
+    CNurikabeBitBoard &d = d_;
+
+    for (;;) {
+      dilate(seed, d);
+
+      d &= mask;
+      d |= seed;
+
+      if (d == seed) break;
+
+      seed = d;
+    }
+  }
+
+  // cells of b connected to cell i (in b)
+  void component(int i, const CNurikabeBitBoard &b, CNurikabeBitBoard &res) const {
+    if (res.numBits() != b.numBits())
+      res.resize(b.numBits());
+    else
+      res.clear();
+
+    res.set(i);
+
+    fill(res, b);
+  }
+
+  // true if cells of b are a single component (false if none)
+  bool isConnected(const CNurikabeBitBoard &b) const {
+    int i = b.firstBit();
+
+    if (i < 0) return false;
+
+    component(i, b, s_);
+
+    return (s_ == b);
+  }
+
+  // true if cell i, or a cell connected to it through cells of mask, is in or next to
+  // target
+  bool isReachable(int i, const CNurikabeBitBoard &mask,
+                   const CNurikabeBitBoard &target) const {
+    CNurikabeBitBoard &seed = s_, &d = d_;
+
+    seed.clear();
+
+    seed.set(i);
+
+    for (;;) {
+      dilate(seed, d);
+
+      if (d.intersects(target)) return true;
+
+      d &= mask;
+      d |= seed;
+
+      if (d == seed) return false;
+
+      seed = d;
+    }
+  }
+
+ private:
+  int               rows_ { 0 };
+  int               cols_ { 0 };
+  CNurikabeBitBoard firstCol_, lastCol_; // edge cells
+  CNurikabeBitBoard firstRow_, lastRow_;
+
+  mutable CNurikabeBitBoard t_, d_, s_; // work boards
+};
+
+#endif
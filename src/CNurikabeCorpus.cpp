@@ -0,0 +1,307 @@
+#include <CNurikabeCorpus.h>
+
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const char *corpusMagic = "NKBC";
+
+CNurikabeCorpus::
+~CNurikabeCorpus()
+{
+  close();
+}
+
+bool
+CNurikabeCorpus::
+open(const std::string &filename)
+{
+  close();
+
+  int fd = ::open(filename.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || std::size_t(st.st_size) < sizeof(Header)) {
+    ::close(fd);
+    return false;
+  }
+
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+  ::close(fd);
+
+  if (data == MAP_FAILED)
+    return false;
+
+  data_ = static_cast<const uint8_t *>(data);
+  size_ = st.st_size;
+
+  // validate header and index
+  Header header;
+
+  memcpy(&header, data_, sizeof(header));
+
+  if (memcmp(header.magic, corpusMagic, 4) != 0 || header.version != VERSION ||
+      header.indexOffset > size_ ||
+      (size_ - header.indexOffset)/sizeof(uint64_t) < header.numPuzzles ||
+      header.indexOffset % sizeof(uint64_t) != 0) {
+    close();
+    return false;
+  }
+
+  index_      = reinterpret_cast<const uint64_t *>(data_ + header.indexOffset);
+  numPuzzles_ = header.numPuzzles;
+
+  // only index is needed up front
+  madvise(const_cast<uint8_t *>(data_), size_, MADV_RANDOM);
+
+  return true;
+}
+
+void
+CNurikabeCorpus::
+close()
+{
+  if (data_)
+    munmap(const_cast<uint8_t *>(data_), size_);
+
+  data_       = nullptr;
+  size_       = 0;
+  index_      = nullptr;
+  numPuzzles_ = 0;
+}
+
+bool
+CNurikabeCorpus::
+getPuzzle(int i, CNurikabe::Puzzle &puzzle) const
+{
+  if (i < 0 || i >= numPuzzles_)
+    return false;
+
+  uint64_t offset = index_[i];
+
+  if (offset > size_ || size_ - offset < sizeof(PuzzleHeader))
+    return false;
+
+  const uint8_t *p = data_ + offset;
+
+  PuzzleHeader header;
+
+  memcpy(&header, p, sizeof(header));
+
+  p += sizeof(header);
+
+  std::size_t num_cells = std::size_t(header.rows)*std::size_t(header.cols);
+
+  if (num_cells == 0 || num_cells > std::size_t(CNurikabe::MAX_CELLS))
+    return false;
+
+  std::size_t cluesSize    = std::size_t(header.numClues)*sizeof(Clue);
+  std::size_t solutionSize = (header.flags & HAS_SOLUTION ? (num_cells + 7)/8 : 0);
+  std::size_t seedSize     = (header.flags & HAS_SEED ? sizeof(uint64_t) : 0);
+
+  if (size_ - offset - sizeof(header) < cluesSize + solutionSize + seedSize)
+    return false;
+
+  puzzle.rows = header.rows;
+  puzzle.cols = header.cols;
+
+  puzzle.values.assign(num_cells, CNurikabe::Cell::UNKNOWN);
+
+  for (uint32_t j = 0; j < header.numClues; ++j, p += sizeof(Clue)) {
+    Clue clue;
+
+    memcpy(&clue, p, sizeof(clue));
+
+    if (clue.index >= uint32_t(num_cells))
+      return false;
+
+    puzzle.values[clue.index] = clue.value;
+  }
+
+  puzzle.solution.clear();
+
+  if (header.flags & HAS_SOLUTION) {
+    puzzle.solution.resize(num_cells);
+
+    for (std::size_t j = 0; j < num_cells; ++j) {
+      bool black = (p[j >> 3] >> (j & 7)) & 1;
+
+      int value = puzzle.values[j];
+
+      if      (value > 0) puzzle.solution[j] = value;
+      else if (black    ) puzzle.solution[j] = CNurikabe::Cell::BLACK;
+      else                puzzle.solution[j] = CNurikabe::Cell::WHITE;
+    }
+
+    p += solutionSize;
+  }
+
+  puzzle.seed = 0;
+
+  if (header.flags & HAS_SEED)
+    memcpy(&puzzle.seed, p, sizeof(puzzle.seed));
+
+  return true;
+}
+
+//------
+
+CNurikabeCorpusWriter::
+~CNurikabeCorpusWriter()
+{
+  if (fp_)
+    fclose(fp_);
+}
+
+bool
+CNurikabeCorpusWriter::
+open(const std::string &filename)
+{
+  if (fp_)
+    fclose(fp_);
+
+  offsets_.clear();
+
+  fp_ = fopen(filename.c_str(), "wb");
+
+  if (! fp_)
+    return false;
+
+  pos_ = 0;
+
+  // placeholder header (rewritten on close)
+  CNurikabeCorpus::Header header;
+
+  memset(&header, 0, sizeof(header));
+
+  return write(&header, sizeof(header));
+}
+
+bool
+CNurikabeCorpusWriter::
+addPuzzle(const CNurikabe::Puzzle &puzzle)
+{
+  if (! fp_)
+    return false;
+
+  if (puzzle.rows <= 0 || puzzle.rows > 0xFFFF || puzzle.cols <= 0 || puzzle.cols > 0xFFFF)
+    return false;
+
+  if (int64_t(puzzle.rows)*puzzle.cols > CNurikabe::MAX_CELLS)
+    return false;
+
+  int num_cells = puzzle.rows*puzzle.cols;
+
+  if (int(puzzle.values.size()) != num_cells)
+    return false;
+
+  if (puzzle.hasSolution() && int(puzzle.solution.size()) != num_cells)
+    return false;
+
+  std::vector<CNurikabeCorpus::Clue> clues;
+
+  for (int i = 0; i < num_cells; ++i) {
+    if (puzzle.values[i] == CNurikabe::Cell::UNKNOWN) continue;
+
+    CNurikabeCorpus::Clue clue;
+
+    clue.index = i;
+    clue.value = puzzle.values[i];
+
+    clues.push_back(clue);
+  }
+
+  CNurikabeCorpus::PuzzleHeader header;
+
+  header.rows     = puzzle.rows;
+  header.cols     = puzzle.cols;
+  header.numClues = clues.size();
+  header.flags    = (puzzle.hasSolution() ? CNurikabeCorpus::HAS_SOLUTION : 0) |
+                    (puzzle.seed            ? CNurikabeCorpus::HAS_SEED     : 0);
+
+  // record start (indexed only when complete)
+  uint64_t pos = pos_;
+
+  if (! write(&header, sizeof(header)))
+    return false;
+
+  if (! clues.empty() && ! write(&clues[0], clues.size()*sizeof(CNurikabeCorpus::Clue)))
+    return false;
+
+  if (puzzle.hasSolution()) {
+    std::vector<uint8_t> bits((num_cells + 7)/8, 0);
+
+    for (int i = 0; i < num_cells; ++i) {
+      if (puzzle.solution[i] == CNurikabe::Cell::BLACK)
+        bits[i >> 3] |= uint8_t(1 << (i & 7));
+    }
+
+    if (! write(&bits[0], bits.size()))
+      return false;
+  }
+
+  if (puzzle.seed && ! write(&puzzle.seed, sizeof(puzzle.seed)))
+    return false;
+
+  offsets_.push_back(pos);
+
+  return true;
+}
+
+bool
+CNurikabeCorpusWriter::
+close()
+{
+  if (! fp_)
+    return false;
+
+  // align index
+  uint8_t pad[sizeof(uint64_t)] = { 0 };
+
+  bool rc = write(pad, (sizeof(uint64_t) - pos_ % sizeof(uint64_t)) % sizeof(uint64_t));
+
+  CNurikabeCorpus::Header header;
+
+  memset(&header, 0, sizeof(header));
+
+  memcpy(header.magic, corpusMagic, 4);
+
+  header.version     = CNurikabeCorpus::VERSION;
+  header.numPuzzles  = offsets_.size();
+  header.indexOffset = pos_;
+
+  if (rc && ! offsets_.empty())
+    rc = write(&offsets_[0], offsets_.size()*sizeof(uint64_t));
+
+  if (rc)
+    rc = (fseek(fp_, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp_) == 1);
+
+  if (fclose(fp_) != 0)
+    rc = false;
+
+  fp_ = nullptr;
+
+  return rc;
+}
+
+bool
+CNurikabeCorpusWriter::
+write(const void *data, std::size_t size)
+{
+  if (size == 0)
+    return true;
+
+  if (fwrite(data, size, 1, fp_) != 1)
+    return false;
+
+  pos_ += size;
+
+  return true;
+}
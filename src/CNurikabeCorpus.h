@@ -0,0 +1,109 @@
+#ifndef CNurikabeCorpus_H
+#define CNurikabeCorpus_H
+
+#include <CNurikabe.h>
+
+#include <cstdint>
+#include <cstdio>
+
+// Binary puzzle corpus (native byte order)
+//
+//  header : char[4] magic "NKBC", uint32 version, uint32 num puzzles, uint32 reserved,
+//           uint64 index offset
+//  puzzle : uint16 rows, uint16 cols, uint32 num clues, uint32 flags,
+//           num clues * (uint32 cell index, int32 value),
+//           if flags has solution: solution bitmap ((rows*cols + 7)/8 bytes, 1 = black)
+//           if flags has seed: uint64 generator seed
+//  index  : num puzzles * uint64 puzzle offset
+//
+// clues are number cells and any pre-set white/black cells (Cell::Value)
+
+class CNurikabeCorpus {
+ public:
+  enum { VERSION = 1 };
+
+  enum Flags {
+    HAS_SOLUTION = (1<<0),
+    HAS_SEED     = (1<<1)
+  };
+
+  struct Header {
+    char     magic[4];
+    uint32_t version;
+    uint32_t numPuzzles;
+    uint32_t reserved;
+    uint64_t indexOffset;
+  };
+
+  struct PuzzleHeader {
+    uint16_t rows;
+    uint16_t cols;
+    uint32_t numClues;
+    uint32_t flags;
+  };
+
+  struct Clue {
+    uint32_t index;
+    int32_t  value;
+  };
+
+ public:
+  CNurikabeCorpus() { }
+
+ ~CNurikabeCorpus();
+
+  // map corpus file into memory
+  bool open(const std::string &filename);
+
+  void close();
+
+  bool isOpen() const { return data_ != nullptr; }
+
+  int size() const { return numPuzzles_; }
+
+  // decode single puzzle (only touches that puzzle's bytes)
+  bool getPuzzle(int i, CNurikabe::Puzzle &puzzle) const;
+
+ private:
+  CNurikabeCorpus(const CNurikabeCorpus &) = delete;
+  CNurikabeCorpus &operator=(const CNurikabeCorpus &) = delete;
+
+ private:
+  const uint8_t  *data_       { nullptr };
+  std::size_t     size_       { 0 };
+  const uint64_t *index_      { nullptr };
+  int             numPuzzles_ { 0 };
+};
+
+//------
+
+class CNurikabeCorpusWriter {
+ public:
+  CNurikabeCorpusWriter() { }
+
+ ~CNurikabeCorpusWriter();
+
+  bool open(const std::string &filename);
+
+  bool addPuzzle(const CNurikabe::Puzzle &puzzle);
+
+  // write index and header
+  bool close();
+
+  int size() const { return offsets_.size(); }
+
+ private:
+  CNurikabeCorpusWriter(const CNurikabeCorpusWriter &) = delete;
+  CNurikabeCorpusWriter &operator=(const CNurikabeCorpusWriter &) = delete;
+
+  bool write(const void *data, std::size_t size);
+
+ private:
+  typedef std::vector<uint64_t> Offsets;
+
+  FILE    *fp_     { nullptr };
+  uint64_t pos_    { 0 };
+  Offsets  offsets_;
+};
+
+#endif
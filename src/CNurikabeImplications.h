@@ -0,0 +1,241 @@
+#ifndef CNurikabeImplications_H
+#define CNurikabeImplications_H
+
+#include <CNurikabeBitBoard.h>
+#include <vector>
+#include <set>
+#include <algorithm>
+#include <cstdint>
+
+// Binary implication graph between cell literals (cell black, cell white).
+//
+// Two cell constraints (e.g. one of two cells of a 2x2 block must be white) are stored
+// as clauses (l1 or l2), i.e. edges not l1 -> l2 and not l2 -> l1. Clauses only hold
+// for the board they were derived from and its descendants, so are added at the top
+// level and kept until the board is reset.
+//
+// solve() applies the clauses to the current cell values: unit propagation from known
+// cells, then strongly connected components over the unknown literals. A literal which
+// implies its negation is false; a literal in the same component as its negation is a
+// contradiction.
+class CNurikabeImplications {
+ public:
+  // cell value
+  enum Value {
+    UNKNOWN = -1,
+    BLACK   = 0,
+    WHITE   = 1
+  };
+
+ public:
+  static int literal(int ind, Value value) { return 2*ind + int(value); }
+
+  static int negate(int lit) { return lit ^ 1; }
+
+  static int literalCell(int lit) { return lit >> 1; }
+
+  static Value literalValue(int lit) { return Value(lit & 1); }
+
+ public:
+  CNurikabeImplications(int numCells=0) {
+    resize(numCells);
+  }
+
+  void resize(int numCells) {
+    numCells_ = numCells;
+
+    clear();
+  }
+
+  void clear() {
+    edges_.assign(2*numCells_, std::vector<int>());
+
+    clauses_.clear();
+  }
+
+  int numClauses() const { return clauses_.size(); }
+
+  // add clause (lit1 or lit2), returns false if already added
+  bool addClause(int lit1, int lit2) {
+    if (lit1 > lit2) std::swap(lit1, lit2);
+
+    if (! clauses_.insert(std::make_pair(lit1, lit2)).second)
+      return false;
+
+    edges_[negate(lit1)].push_back(lit2);
+    edges_[negate(lit2)].push_back(lit1);
+
+    return true;
+  }
+
+  // get values of unknown cells forced by clauses (values per cell, updated with
+  // forced values), returns false if values contradict clauses
+  bool solve(std::vector<int> &values, std::vector<int> &forced) const {
+    forced.clear();
+
+    if (clauses_.empty()) return true;
+
+    if (! propagate(values, forced))
+      return false;
+
+    //---
+
+    // strongly connected components of unknown literals (Tarjan, iterative)
+    int numLits = 2*numCells_;
+
+    std::vector<int> disc(numLits, 0), low(numLits, 0), comp(numLits, -1), dir(numLits, 0);
+    std::vector<int> stack, path;
+
+    int order    = 0;
+    int numComps = 0;
+
+    for (int root = 0; root < numLits; ++root) {
+      if (disc[root] || values[literalCell(root)] != UNKNOWN || edges_[root].empty())
+        continue;
+
+      disc[root] = low[root] = ++order;
+
+      stack.push_back(root);
+      path .push_back(root);
+
+      while (! path.empty()) {
+        int lit = path.back();
+
+        const std::vector<int> &edges = edges_[lit];
+
+        if (dir[lit] < int(edges.size())) {
+          int lit1 = edges[dir[lit]++];
+
+          if (values[literalCell(lit1)] != UNKNOWN) continue;
+
+          if      (! disc[lit1]) {
+            disc[lit1] = low[lit1] = ++order;
+
+            stack.push_back(lit1);
+            path .push_back(lit1);
+          }
+          else if (comp[lit1] < 0)
+            low[lit] = std::min(low[lit], disc[lit1]);
+
+          continue;
+        }
+
+        path.pop_back();
+
+        if (! path.empty())
+          low[path.back()] = std::min(low[path.back()], low[lit]);
+
+        if (low[lit] == disc[lit]) {
+          int lit1;
+
+          do {
+            lit1 = stack.back();
+
+            stack.pop_back();
+
+            comp[lit1] = numComps;
+          } while (lit1 != lit);
+
+          ++numComps;
+        }
+      }
+    }
+
+    if (numComps == 0) return true;
+
+    // components are numbered in reverse topological order so successors of a
+    // component are complete before it
+    std::vector<CNurikabeBitBoard> reach(numComps, CNurikabeBitBoard(numComps));
+    std::vector<std::vector<int>>  compLits(numComps);
+
+    for (int lit = 0; lit < numLits; ++lit)
+      if (comp[lit] >= 0)
+        compLits[comp[lit]].push_back(lit);
+
+    for (int c = 0; c < numComps; ++c) {
+      reach[c].set(c);
+
+      for (std::size_t i = 0; i < compLits[c].size(); ++i) {
+        const std::vector<int> &edges = edges_[compLits[c][i]];
+
+        for (std::size_t j = 0; j < edges.size(); ++j) {
+          int c1 = comp[edges[j]];
+
+          if (c1 >= 0 && c1 != c)
+            reach[c] |= reach[c1];
+        }
+      }
+    }
+
+    // literal implying its negation is false
+    std::vector<int> forced1;
+
+    for (int lit = 0; lit < numLits; ++lit) {
+      int c = comp[lit], nc = comp[negate(lit)];
+
+      if (c < 0 || nc < 0) continue;
+
+      if (c == nc)
+        return false;
+
+      if (reach[c].test(nc))
+        forced1.push_back(negate(lit));
+    }
+
+    for (std::size_t i = 0; i < forced1.size(); ++i) {
+      int ind = literalCell(forced1[i]);
+
+      if (values[ind] != UNKNOWN) continue;
+
+      values[ind] = literalValue(forced1[i]);
+
+      forced.push_back(forced1[i]);
+    }
+
+    return true;
+  }
+
+ private:
+  // set literals implied by known cells
+  bool propagate(std::vector<int> &values, std::vector<int> &forced) const {
+    std::vector<int> queue;
+
+    for (int ind = 0; ind < numCells_; ++ind)
+      if (values[ind] != UNKNOWN)
+        queue.push_back(literal(ind, Value(values[ind])));
+
+    while (! queue.empty()) {
+      int lit = queue.back();
+
+      queue.pop_back();
+
+      const std::vector<int> &edges = edges_[lit];
+
+      for (std::size_t i = 0; i < edges.size(); ++i) {
+        int lit1 = edges[i];
+        int ind1 = literalCell(lit1);
+
+        if      (values[ind1] == UNKNOWN) {
+          values[ind1] = literalValue(lit1);
+
+          forced.push_back(lit1);
+
+          queue.push_back(lit1);
+        }
+        else if (values[ind1] != literalValue(lit1))
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  typedef std::pair<int, int> Clause;
+
+  int                           numCells_ { 0 };
+  std::vector<std::vector<int>> edges_;   // implications per literal
+  std::set<Clause>              clauses_;
+};
+
+#endif
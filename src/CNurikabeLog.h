@@ -0,0 +1,181 @@
+#ifndef CNurikabeLog_H
+#define CNurikabeLog_H
+
+#include <CNurikabe.h>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <cstring>
+
+// Structured solver trace.
+//
+// Events are written as one JSON object per line (ndjson) to stderr, or to the file named
+// by CNURIKABE_LOG_FILE. The level is set by CNURIKABE_LOG (error, info, debug, trace or
+// 1-4, any other non empty value enables all events).
+//
+// Log through the CNURIKABE_TRACE macro so arguments are only evaluated when the level is
+// enabled. Building with CNURIKABE_NO_TRACE defined removes all trace calls.
+//
+// "change" events record the rule and the cells it set black or white, in order, so a
+// trace at debug level or above can be replayed onto the initial board.
+class CNurikabeLog {
+ public:
+  enum Level {
+    LEVEL_NONE  = 0,
+    LEVEL_ERROR = 1,
+    LEVEL_INFO  = 2,
+    LEVEL_DEBUG = 3,
+    LEVEL_TRACE = 4
+  };
+
+  // single instance (function local static so initialization is thread safe)
+  static CNurikabeLog &instance() {
+    static CNurikabeLog log;
+
+    return log;
+  }
+
+  bool isEnabled(Level level) const {
+    return level <= level_.load(std::memory_order_relaxed);
+  }
+
+  Level getLevel() const { return Level(level_.load()); }
+  void setLevel(Level level) { level_ = level; }
+
+  // write event with key, value argument pairs
+  template<typename... Args>
+  void event(Level level, const char *name, const Args &... args) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    std::ostream &os = (file_.is_open() ? file_ : std::cerr);
+
+    double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+
+    os << "{\"t\":" << t << ",\"level\":\"" << levelName(level) << "\",\"event\":";
+
+    writeValue(os, name);
+
+    writeFields(os, args...);
+
+    os << "}\n";
+
+    if (level <= LEVEL_ERROR)
+      os.flush();
+  }
+
+  // write quoted JSON string (quote, backslash and newline escaped)
+  static void writeString(std::ostream &os, const char *str) {
+    os << "\"";
+
+    for ( ; *str; ++str) {
+      if      (*str == '"' || *str == '\\') os << '\\' << *str;
+      else if (*str == '\n')                os << "\\n";
+      else                                  os << *str;
+    }
+
+    os << "\"";
+  }
+
+ private:
+  CNurikabeLog() :
+   start_(std::chrono::steady_clock::now()) {
+    const char *env = getenv("CNURIKABE_LOG");
+
+    if (env && *env) {
+      if      (strcmp(env, "error") == 0 || strcmp(env, "1") == 0) level_ = LEVEL_ERROR;
+      else if (strcmp(env, "info" ) == 0 || strcmp(env, "2") == 0) level_ = LEVEL_INFO;
+      else if (strcmp(env, "debug") == 0 || strcmp(env, "3") == 0) level_ = LEVEL_DEBUG;
+      else                                                         level_ = LEVEL_TRACE;
+    }
+
+    const char *filename = getenv("CNURIKABE_LOG_FILE");
+
+    if (filename && *filename)
+      file_.open(filename);
+  }
+
+  static const char *levelName(Level level) {
+    switch (level) {
+      case LEVEL_ERROR: return "error";
+      case LEVEL_INFO : return "info";
+      case LEVEL_DEBUG: return "debug";
+      case LEVEL_TRACE: return "trace";
+      default         : return "none";
+    }
+  }
+
+  static void writeFields(std::ostream &) { }
+
+  template<typename T, typename... Args>
+  static void writeFields(std::ostream &os, const char *key, const T &value,
+                          const Args &... args) {
+    os << ",";
+
+    writeValue(os, key);
+
+    os << ":";
+
+    writeValue(os, value);
+
+    writeFields(os, args...);
+  }
+
+  static void writeValue(std::ostream &os, int i) { os << i; }
+  static void writeValue(std::ostream &os, long i) { os << i; }
+  static void writeValue(std::ostream &os, unsigned long i) { os << i; }
+  static void writeValue(std::ostream &os, double r) { os << r; }
+  static void writeValue(std::ostream &os, bool b) { os << (b ? "true" : "false"); }
+
+  static void writeValue(std::ostream &os, const char *str) { writeString(os, str); }
+
+  static void writeValue(std::ostream &os, const std::string &str) {
+    writeValue(os, str.c_str());
+  }
+
+  static void writeValue(std::ostream &os, const CNurikabe::Coord &coord) {
+    os << "[" << coord.row << "," << coord.col << "]";
+  }
+
+  template<typename T>
+  static void writeCoords(std::ostream &os, const T &coords) {
+    os << "[";
+
+    for (auto p = coords.begin(); p != coords.end(); ++p) {
+      if (p != coords.begin()) os << ",";
+
+      writeValue(os, *p);
+    }
+
+    os << "]";
+  }
+
+  static void writeValue(std::ostream &os, const CNurikabe::Coords &coords) {
+    writeCoords(os, coords);
+  }
+
+  static void writeValue(std::ostream &os, const CNurikabe::CoordArray &coords) {
+    writeCoords(os, coords);
+  }
+
+ private:
+  typedef std::chrono::steady_clock::time_point TimePoint;
+
+  std::atomic<int> level_ { LEVEL_NONE };
+  std::mutex       mutex_;
+  std::ofstream    file_;
+  TimePoint        start_;
+};
+
+#ifdef CNURIKABE_NO_TRACE
+#define CNURIKABE_TRACE(level, ...) do { } while (false)
+#else
+#define CNURIKABE_TRACE(level, ...) \
+  do { \
+    if (CNurikabeLog::instance().isEnabled(CNurikabeLog::LEVEL_##level)) \
+      CNurikabeLog::instance().event(CNurikabeLog::LEVEL_##level, __VA_ARGS__); \
+  } while (false)
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef CNurikabeNogoods_H
+#define CNurikabeNogoods_H
+
+#include <CNurikabeImplications.h>
+#include <vector>
+#include <set>
+#include <algorithm>
+
+// Bounded database of learned clauses over cell literals (see CNurikabeImplications).
+//
+// A nogood is a set of cell values which the solver found contradictory (by search),
+// stored as the clause of their negations. Like the implications they only hold for
+// the board they were learned on and its descendants, so are kept until the board is
+// reset. When full the longest (then oldest) clause is dropped, short clauses prune
+// most.
+class CNurikabeNogoods {
+ public:
+  typedef std::vector<int> Clause;
+
+ public:
+  CNurikabeNogoods(int maxClauses=1000) :
+   maxClauses_(maxClauses) {
+  }
+
+  int getMaxClauses() const { return maxClauses_; }
+  void setMaxClauses(int n) { maxClauses_ = n; }
+
+  void clear() {
+    clauses_.clear();
+    keys_   .clear();
+  }
+
+  int numClauses() const { return clauses_.size(); }
+
+  const Clause &clause(int i) const { return clauses_[i]; }
+
+  // add clause (or of literals), returns false if empty, already added or no room
+  bool addClause(Clause clause) {
+    if (clause.empty() || maxClauses_ <= 0) return false;
+
+    std::sort(clause.begin(), clause.end());
+
+    clause.erase(std::unique(clause.begin(), clause.end()), clause.end());
+
+    if (! keys_.insert(clause).second)
+      return false;
+
+    if (int(clauses_.size()) >= maxClauses_) {
+      std::size_t worst = 0;
+
+      for (std::size_t i = 1; i < clauses_.size(); ++i)
+        if (clauses_[i].size() > clauses_[worst].size())
+          worst = i;
+
+      keys_.erase(clauses_[worst]);
+
+      clauses_.erase(clauses_.begin() + worst);
+    }
+
+    clauses_.push_back(clause);
+
+    return true;
+  }
+
+  // set literals forced by clauses (values per cell, updated with forced values),
+  // returns false if a clause has all literals false
+  bool propagate(std::vector<int> &values, std::vector<int> &forced) const {
+    forced.clear();
+
+    bool changed = true;
+
+    while (changed) {
+      changed = false;
+
+      for (std::size_t i = 0; i < clauses_.size(); ++i) {
+        const Clause &clause = clauses_[i];
+
+        int  unknownLit = -1;
+        int  numUnknown = 0;
+        bool satisfied  = false;
+
+        for (std::size_t j = 0; j < clause.size(); ++j) {
+          int lit   = clause[j];
+          int value = values[CNurikabeImplications::literalCell(lit)];
+
+          if      (value == CNurikabeImplications::UNKNOWN) {
+            unknownLit = lit;
+
+            ++numUnknown;
+          }
+          else if (value == CNurikabeImplications::literalValue(lit)) {
+            satisfied = true;
+            break;
+          }
+        }
+
+        if (satisfied || numUnknown > 1) continue;
+
+        if (numUnknown == 0)
+          return false;
+
+        values[CNurikabeImplications::literalCell(unknownLit)] =
+          CNurikabeImplications::literalValue(unknownLit);
+
+        forced.push_back(unknownLit);
+
+        changed = true;
+      }
+    }
+
+    return true;
+  }
+
+ private:
+  typedef std::vector<Clause> Clauses;
+  typedef std::set<Clause>    ClauseKeys;
+
+  int        maxClauses_ { 1000 };
+  Clauses    clauses_;
+  ClauseKeys keys_;    // for duplicate check
+};
+
+#endif
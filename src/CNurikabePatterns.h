@@ -0,0 +1,107 @@
+#ifndef CNurikabePatterns_H
+#define CNurikabePatterns_H
+
+#include <cstdint>
+
+// Local deductions for a cell from its 3x3 neighbourhood.
+//
+// The eight neighbours are encoded two bits each (unknown, white, black or off board)
+// into a 16 bit pattern. A table, built at compile time, gives the colors the centre
+// cell can't be:
+//  . not black if it would complete a 2x2 black block
+//  . not white if it is enclosed by black (only a 1 clue can be)
+//  . enclosed by white, so only black if it is the board's only black cell
+class CNurikabePatterns {
+ public:
+  // neighbour state
+  enum State {
+    UNKNOWN = 0,
+    WHITE   = 1, // white or number
+    BLACK   = 2,
+    EDGE    = 3  // off board
+  };
+
+  // neighbour position (pattern bits 2*dir)
+  enum Dir {
+    NW = 0, N = 1, NE = 2,
+    W  = 3,        E  = 4,
+    SW = 5, S = 6, SE = 7
+  };
+
+  // result flags
+  enum Flags {
+    NOT_BLACK      = (1<<0),
+    NOT_WHITE      = (1<<1),
+    ISOLATED_BLACK = (1<<2)  // not black unless single black cell
+  };
+
+  static constexpr int NUM_PATTERNS = 1<<16;
+
+ public:
+  static constexpr int addState(int pattern, Dir dir, State state) {
+    return pattern | (int(state) << (2*int(dir)));
+  }
+
+  static constexpr State getState(int pattern, Dir dir) {
+    return State((pattern >> (2*int(dir))) & 3);
+  }
+
+  // table lookup
+  static int getFlags(int pattern) { return table_.flags[pattern]; }
+
+  // rules used to build table
+  static constexpr int calcFlags(int pattern) {
+    bool n = (getState(pattern, N) == BLACK), s = (getState(pattern, S) == BLACK);
+    bool e = (getState(pattern, E) == BLACK), w = (getState(pattern, W) == BLACK);
+
+    int flags = 0;
+
+    // 2x2 black block
+    if ((n && e && getState(pattern, NE) == BLACK) ||
+        (n && w && getState(pattern, NW) == BLACK) ||
+        (s && e && getState(pattern, SE) == BLACK) ||
+        (s && w && getState(pattern, SW) == BLACK))
+      flags |= NOT_BLACK;
+
+    // enclosed by white (or edge)
+    if (isWhiteOrEdge(pattern, N) && isWhiteOrEdge(pattern, S) &&
+        isWhiteOrEdge(pattern, E) && isWhiteOrEdge(pattern, W))
+      flags |= ISOLATED_BLACK;
+
+    // enclosed by black (or edge)
+    if (isBlackOrEdge(pattern, N) && isBlackOrEdge(pattern, S) &&
+        isBlackOrEdge(pattern, E) && isBlackOrEdge(pattern, W))
+      flags |= NOT_WHITE;
+
+    return flags;
+  }
+
+ private:
+  static constexpr bool isWhiteOrEdge(int pattern, Dir dir) {
+    State state = getState(pattern, dir);
+
+    return (state == WHITE || state == EDGE);
+  }
+
+  static constexpr bool isBlackOrEdge(int pattern, Dir dir) {
+    State state = getState(pattern, dir);
+
+    return (state == BLACK || state == EDGE);
+  }
+
+  struct Table {
+    constexpr Table() :
+     flags() {
+      for (int i = 0; i < NUM_PATTERNS; ++i)
+        flags[i] = uint8_t(calcFlags(i));
+    }
+
+    uint8_t flags[NUM_PATTERNS];
+  };
+
+  static const Table table_;
+};
+
+inline constexpr CNurikabePatterns::Table CNurikabePatterns::table_ {};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef CNurikabeRand_H
+#define CNurikabeRand_H
+
+#include <cstdint>
+
+// Seedable random number generator (xoshiro256**, state seeded by splitmix64)
+//
+// Each generator/solver owns its own instance so sequences are reproducible from the
+// seed and independent of other threads. Meets UniformRandomBitGenerator so can be
+// used with std algorithms.
+class CNurikabeRand {
+ public:
+  typedef uint64_t result_type;
+
+ public:
+  CNurikabeRand(uint64_t seed=0) {
+    this->seed(seed);
+  }
+
+  void seed(uint64_t seed) {
+    seed_ = seed;
+
+    for (int i = 0; i < 4; ++i)
+      s_[i] = splitMix(seed);
+  }
+
+  uint64_t getSeed() const { return seed_; }
+
+  static constexpr uint64_t min() { return 0; }
+  static constexpr uint64_t max() { return UINT64_MAX; }
+
+  uint64_t operator()() { return next(); }
+
+  uint64_t next() {
+    uint64_t result = rotl(s_[1]*5, 7)*9;
+
+    uint64_t t = s_[1] << 17;
+
+    s_[2] ^= s_[0];
+    s_[3] ^= s_[1];
+    s_[1] ^= s_[2];
+    s_[0] ^= s_[3];
+
+    s_[2] ^= t;
+
+    s_[3] = rotl(s_[3], 45);
+
+    return result;
+  }
+
+  // unbiased random integer in [0, n) (n > 0)
+  int randInt(int n) {
+    uint32_t n1 = uint32_t(n);
+
+    uint64_t m = (next() >> 32)*n1;
+
+    if (uint32_t(m) < n1) {
+      uint32_t threshold = uint32_t(-n1) % n1;
+
+      while (uint32_t(m) < threshold)
+        m = (next() >> 32)*n1;
+    }
+
+    return int(m >> 32);
+  }
+
+  // random element of indexable container (must not be empty)
+  template<typename T>
+  const typename T::value_type &pick(const T &c) {
+    return c[randInt(int(c.size()))];
+  }
+
+  // random real in [0, 1)
+  double randReal() {
+    return double(next() >> 11)*(1.0/9007199254740992.0);
+  }
+
+ private:
+  static uint64_t rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  static uint64_t splitMix(uint64_t &x) {
+    uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+  }
+
+ private:
+  uint64_t seed_ { 0 };
+  uint64_t s_[4];
+};
+
+#endif
@@ -0,0 +1,380 @@
+#include <CNurikabeTrace.h>
+
+#include <algorithm>
+#include <cstring>
+
+static const char *traceMagic = "NKTR";
+
+enum { TRACE_VERSION = 1 };
+
+enum RecordType {
+  RECORD_END  = 0,
+  RECORD_RULE = 1,
+  RECORD_STEP = 2
+};
+
+CNurikabeTraceWriter::
+CNurikabeTraceWriter(std::ostream &os) :
+ os_(os)
+{
+}
+
+void
+CNurikabeTraceWriter::
+start(const CNurikabe::Puzzle &puzzle)
+{
+  cols_     = puzzle.cols;
+  numSteps_ = 0;
+
+  // rule ids are per trace so each trace can be read on its own
+  ruleIds_.clear();
+
+  os_.write(traceMagic, 4);
+
+  writeUInt(TRACE_VERSION);
+  writeUInt(puzzle.rows);
+  writeUInt(puzzle.cols);
+
+  int numClues = 0;
+
+  for (std::size_t i = 0; i < puzzle.values.size(); ++i)
+    if (puzzle.values[i] != CNurikabe::Cell::UNKNOWN)
+      ++numClues;
+
+  writeUInt(numClues);
+
+  int lastIndex = 0;
+
+  for (std::size_t i = 0; i < puzzle.values.size(); ++i) {
+    if (puzzle.values[i] == CNurikabe::Cell::UNKNOWN) continue;
+
+    writeUInt(i - lastIndex);
+    writeInt (puzzle.values[i]);
+
+    lastIndex = i;
+  }
+}
+
+void
+CNurikabeTraceWriter::
+addStep(const std::string &rule, const CNurikabe::CoordArray &blackCoords,
+        const CNurikabe::CoordArray &whiteCoords)
+{
+  RuleIds::const_iterator p = ruleIds_.find(rule);
+
+  int id;
+
+  if (p == ruleIds_.end()) {
+    id = ruleIds_.size();
+
+    ruleIds_[rule] = id;
+
+    writeUInt(RECORD_RULE);
+    writeUInt(id);
+    writeString(rule);
+  }
+  else
+    id = (*p).second;
+
+  writeUInt(RECORD_STEP);
+  writeUInt(id);
+  writeUInt(blackCoords.size());
+  writeUInt(whiteCoords.size());
+
+  writeCoords(blackCoords);
+  writeCoords(whiteCoords);
+
+  ++numSteps_;
+}
+
+void
+CNurikabeTraceWriter::
+end()
+{
+  writeUInt(RECORD_END);
+
+  os_.flush();
+}
+
+void
+CNurikabeTraceWriter::
+writeCoords(const CNurikabe::CoordArray &coords)
+{
+  std::vector<int> inds;
+
+  for (std::size_t i = 0; i < coords.size(); ++i)
+    inds.push_back(coords[i].row*cols_ + coords[i].col);
+
+  std::sort(inds.begin(), inds.end());
+
+  int lastInd = 0;
+
+  for (std::size_t i = 0; i < inds.size(); ++i) {
+    writeUInt(inds[i] - lastInd);
+
+    lastInd = inds[i];
+  }
+}
+
+void
+CNurikabeTraceWriter::
+writeString(const std::string &str)
+{
+  writeUInt(str.size());
+
+  os_.write(str.c_str(), str.size());
+}
+
+void
+CNurikabeTraceWriter::
+writeUInt(uint64_t i)
+{
+  char buffer[10];
+
+  int n = 0;
+
+  while (i >= 0x80) {
+    buffer[n++] = char((i & 0x7f) | 0x80);
+
+    i >>= 7;
+  }
+
+  buffer[n++] = char(i);
+
+  os_.write(buffer, n);
+}
+
+void
+CNurikabeTraceWriter::
+writeInt(int64_t i)
+{
+  writeUInt((uint64_t(i) << 1) ^ uint64_t(i >> 63));
+}
+
+//-------------
+
+CNurikabeTraceReader::
+CNurikabeTraceReader(std::istream &is) :
+ buf_(is.rdbuf())
+{
+}
+
+bool
+CNurikabeTraceReader::
+start(CNurikabe::Puzzle &puzzle)
+{
+  rules_.clear();
+
+  char magic[4];
+
+  if (buf_->sgetn(magic, 4) != 4)
+    return false; // end of stream
+
+  uint64_t version, rows, cols, numClues;
+
+  if (memcmp(magic, traceMagic, 4) != 0 || ! readUInt(version) || version != TRACE_VERSION ||
+      ! readUInt(rows) || ! readUInt(cols) || ! readUInt(numClues) ||
+      rows == 0 || cols == 0 ||
+      rows > uint64_t(CNurikabe::MAX_CELLS) || cols > uint64_t(CNurikabe::MAX_CELLS) ||
+      rows*cols > uint64_t(CNurikabe::MAX_CELLS) || numClues > rows*cols) {
+    error_ = true;
+    return false;
+  }
+
+  rows_ = int(rows);
+  cols_ = int(cols);
+
+  puzzle.rows = rows_;
+  puzzle.cols = cols_;
+
+  puzzle.values.clear();
+  puzzle.values.resize(rows_*cols_, CNurikabe::Cell::UNKNOWN);
+
+  puzzle.solution.clear();
+
+  uint64_t index = 0;
+
+  for (uint64_t i = 0; i < numClues; ++i) {
+    uint64_t delta;
+    int64_t  value;
+
+    if (! readUInt(delta) || ! readInt(value)) {
+      error_ = true;
+      return false;
+    }
+
+    // check before adding so large delta can't wrap index
+    if (delta >= uint64_t(rows_*cols_) - index) {
+      error_ = true;
+      return false;
+    }
+
+    index += delta;
+
+    puzzle.values[index] = int(value);
+  }
+
+  return true;
+}
+
+bool
+CNurikabeTraceReader::
+next(Step &step)
+{
+  for (;;) {
+    uint64_t type;
+
+    if (! readUInt(type)) {
+      error_ = true;
+      return false;
+    }
+
+    if      (type == RECORD_END)
+      return false;
+    else if (type == RECORD_RULE) {
+      uint64_t id;
+
+      std::string name;
+
+      if (! readUInt(id) || id != rules_.size() || ! readString(name)) {
+        error_ = true;
+        return false;
+      }
+
+      rules_.push_back(name);
+    }
+    else if (type == RECORD_STEP) {
+      uint64_t id, numBlack, numWhite;
+
+      if (! readUInt(id) || id >= rules_.size() ||
+          ! readUInt(numBlack) || ! readUInt(numWhite) ||
+          numBlack + numWhite > uint64_t(rows_*cols_) ||
+          ! readCoords(int(numBlack), step.blackCoords) ||
+          ! readCoords(int(numWhite), step.whiteCoords)) {
+        error_ = true;
+        return false;
+      }
+
+      step.rule = rules_[id];
+
+      return true;
+    }
+    else {
+      error_ = true;
+      return false;
+    }
+  }
+}
+
+int
+CNurikabeTraceReader::
+replay(CNurikabe &nurikabe, int maxSteps)
+{
+  CNurikabe::Puzzle puzzle;
+
+  if (! start(puzzle) || ! nurikabe.init(puzzle))
+    return -1;
+
+  int numSteps = 0;
+
+  Step step;
+
+  while (maxSteps < 0 || numSteps < maxSteps) {
+    if (! next(step))
+      break;
+
+    if (! nurikabe.applyStep(step.rule, step.blackCoords, step.whiteCoords)) {
+      error_ = true;
+      break;
+    }
+
+    ++numSteps;
+  }
+
+  // skip rest of trace
+  if (! error_ && maxSteps >= 0 && numSteps == maxSteps) {
+    while (next(step))
+      ;
+  }
+
+  // update regions, pools, ... for applied cells
+  nurikabe.getGrid()->rebuild();
+
+  nurikabe.flushChanges();
+
+  return (error_ ? -1 : numSteps);
+}
+
+bool
+CNurikabeTraceReader::
+readCoords(int n, CNurikabe::CoordArray &coords)
+{
+  coords.clear();
+
+  uint64_t ind = 0;
+
+  for (int i = 0; i < n; ++i) {
+    uint64_t delta;
+
+    if (! readUInt(delta))
+      return false;
+
+    if (delta >= uint64_t(rows_*cols_) - ind)
+      return false;
+
+    ind += delta;
+
+    coords.push_back(CNurikabe::Coord(int(ind / cols_), int(ind % cols_)));
+  }
+
+  return true;
+}
+
+bool
+CNurikabeTraceReader::
+readString(std::string &str)
+{
+  uint64_t len;
+
+  if (! readUInt(len) || len > 0xFFFF)
+    return false;
+
+  str.resize(len);
+
+  return (buf_->sgetn(&str[0], len) == std::streamsize(len));
+}
+
+bool
+CNurikabeTraceReader::
+readUInt(uint64_t &i)
+{
+  i = 0;
+
+  for (int shift = 0; shift < 64; shift += 7) {
+    int c = buf_->sbumpc();
+
+    if (c == std::char_traits<char>::eof())
+      return false;
+
+    i |= uint64_t(c & 0x7f) << shift;
+
+    if (! (c & 0x80))
+      return true;
+  }
+
+  return false;
+}
+
+bool
+CNurikabeTraceReader::
+readInt(int64_t &i)
+{
+  uint64_t u;
+
+  if (! readUInt(u))
+    return false;
+
+  i = int64_t(u >> 1) ^ -int64_t(u & 1);
+
+  return true;
+}
@@ -0,0 +1,102 @@
+#ifndef CNurikabeTrace_H
+#define CNurikabeTrace_H
+
+#include <CNurikabe.h>
+
+#include <iostream>
+#include <map>
+#include <cstdint>
+
+// Binary deduction trace
+//
+// A trace is the puzzle followed by the ordered list of top level deductions made by the
+// solver (one per Grid::endChange which changed cells). Numbers are unsigned LEB128
+// varints (signed values zig-zag encoded). A stream may hold several traces back to back.
+//
+//  header : char[4] magic "NKTR", varint version, varint rows, varint cols,
+//           varint num clues, num clues * (varint cell index delta, signed varint value)
+//  record : varint type
+//           RULE : varint rule id, varint name length, name bytes
+//           STEP : varint rule id, varint num black, varint num white,
+//                  black then white cell index deltas (each list sorted)
+//           END  : end of trace
+//
+// Rule names are defined by a RULE record before their first STEP.
+
+class CNurikabeTraceWriter {
+ public:
+  CNurikabeTraceWriter(std::ostream &os);
+
+  // write header for puzzle being solved
+  void start(const CNurikabe::Puzzle &puzzle);
+
+  // add deduction
+  void addStep(const std::string &rule, const CNurikabe::CoordArray &blackCoords,
+               const CNurikabe::CoordArray &whiteCoords);
+
+  // write end of trace
+  void end();
+
+  int numSteps() const { return numSteps_; }
+
+ private:
+  void writeCoords(const CNurikabe::CoordArray &coords);
+
+  void writeString(const std::string &str);
+
+  void writeUInt(uint64_t i);
+  void writeInt (int64_t i);
+
+ private:
+  typedef std::map<std::string, int> RuleIds;
+
+  std::ostream &os_;
+  int           cols_     { 0 };
+  RuleIds       ruleIds_;
+  int           numSteps_ { 0 };
+};
+
+//---
+
+class CNurikabeTraceReader {
+ public:
+  struct Step {
+    std::string           rule;
+    CNurikabe::CoordArray blackCoords;
+    CNurikabe::CoordArray whiteCoords;
+  };
+
+ public:
+  CNurikabeTraceReader(std::istream &is);
+
+  // read header of next trace (false at end of stream or on error)
+  bool start(CNurikabe::Puzzle &puzzle);
+
+  // read next deduction (false at end of trace or on error)
+  bool next(Step &step);
+
+  bool isError() const { return error_; }
+
+  // initialise nurikabe from next trace and apply up to max steps (all if < 0)
+  // without solving, returns number of steps applied or -1 on error
+  int replay(CNurikabe &nurikabe, int maxSteps=-1);
+
+ private:
+  bool readCoords(int n, CNurikabe::CoordArray &coords);
+
+  bool readString(std::string &str);
+
+  bool readUInt(uint64_t &i);
+  bool readInt (int64_t &i);
+
+ private:
+  typedef std::vector<std::string> RuleNames;
+
+  std::streambuf *buf_   { nullptr };
+  int             rows_  { 0 };
+  int             cols_  { 0 };
+  RuleNames       rules_;
+  bool            error_ { false };
+};
+
+#endif
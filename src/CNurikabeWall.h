@@ -0,0 +1,164 @@
+#ifndef CNurikabeWall_H
+#define CNurikabeWall_H
+
+#include <vector>
+#include <cstdint>
+
+// Incremental black wall state used while generating boards.
+//
+// Keeps the number of black cells in each 2x2 block and a union-find of black cells
+// so adding a cell is checked in O(1) (amortised) instead of re-validating the board.
+// Cells are indexed row*cols + col; cells are only ever added.
+class CNurikabeWall {
+ public:
+  CNurikabeWall(int rows=0, int cols=0) {
+    resize(rows, cols);
+  }
+
+  void resize(int rows, int cols) {
+    rows_ = rows;
+    cols_ = cols;
+
+    reset();
+  }
+
+  void reset() {
+    int numCells = rows_*cols_;
+
+    black_ .assign(numCells, 0);
+    parent_.assign(numCells, -1);
+
+    blockCount_.assign(rows_ > 1 && cols_ > 1 ? (rows_ - 1)*(cols_ - 1) : 0, 0);
+
+    numBlack_      = 0;
+    numComponents_ = 0;
+  }
+
+  int numBlack() const { return numBlack_; }
+
+  bool isBlack(int ind) const { return black_[ind]; }
+
+  // number of separate black areas (1 when wall is connected)
+  int numComponents() const { return numComponents_; }
+
+  bool isConnected() const { return numComponents_ <= 1; }
+
+  // true if cell is orthogonally next to a black cell
+  bool touchesBlack(int ind) const {
+    int r = ind / cols_, c = ind % cols_;
+
+    return ((r > 0         && black_[ind - cols_]) || (r < rows_ - 1 && black_[ind + cols_]) ||
+            (c > 0         && black_[ind - 1    ]) || (c < cols_ - 1 && black_[ind + 1    ]));
+  }
+
+  // true if making cell black would not complete a 2x2 black block
+  bool canAdd(int ind) const {
+    int r = ind / cols_, c = ind % cols_;
+
+    for (int r1 = r - 1; r1 <= r; ++r1) {
+      if (r1 < 0 || r1 >= rows_ - 1) continue;
+
+      for (int c1 = c - 1; c1 <= c; ++c1) {
+        if (c1 < 0 || c1 >= cols_ - 1) continue;
+
+        if (blockCount_[r1*(cols_ - 1) + c1] == 3)
+          return false;
+      }
+    }
+
+    return true;
+  }
+
+  // true if making all cells black (distinct, not black) would not complete a 2x2 block
+  bool canAdd(const std::vector<int> &inds) const {
+    for (std::size_t i = 0; i < inds.size(); ++i) {
+      int r = inds[i] / cols_, c = inds[i] % cols_;
+
+      for (int r1 = r - 1; r1 <= r; ++r1) {
+        if (r1 < 0 || r1 >= rows_ - 1) continue;
+
+        for (int c1 = c - 1; c1 <= c; ++c1) {
+          if (c1 < 0 || c1 >= cols_ - 1) continue;
+
+          int n = blockCount_[r1*(cols_ - 1) + c1];
+
+          for (std::size_t j = 0; j < inds.size(); ++j) {
+            int r2 = inds[j] / cols_, c2 = inds[j] % cols_;
+
+            if (r2 >= r1 && r2 <= r1 + 1 && c2 >= c1 && c2 <= c1 + 1)
+              ++n;
+          }
+
+          if (n >= 4)
+            return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  // make cell black
+  void add(int ind) {
+    if (black_[ind]) return;
+
+    black_[ind] = 1;
+
+    ++numBlack_;
+
+    int r = ind / cols_, c = ind % cols_;
+
+    for (int r1 = r - 1; r1 <= r; ++r1) {
+      if (r1 < 0 || r1 >= rows_ - 1) continue;
+
+      for (int c1 = c - 1; c1 <= c; ++c1) {
+        if (c1 < 0 || c1 >= cols_ - 1) continue;
+
+        ++blockCount_[r1*(cols_ - 1) + c1];
+      }
+    }
+
+    parent_[ind] = ind;
+
+    ++numComponents_;
+
+    if (r > 0         && black_[ind - cols_]) join(ind, ind - cols_);
+    if (r < rows_ - 1 && black_[ind + cols_]) join(ind, ind + cols_);
+    if (c > 0         && black_[ind - 1    ]) join(ind, ind - 1    );
+    if (c < cols_ - 1 && black_[ind + 1    ]) join(ind, ind + 1    );
+  }
+
+  // representative black cell of cell's area
+  int find(int ind) {
+    while (parent_[ind] != ind) {
+      parent_[ind] = parent_[parent_[ind]]; // path halving
+
+      ind = parent_[ind];
+    }
+
+    return ind;
+  }
+
+ private:
+  void join(int ind1, int ind2) {
+    int root1 = find(ind1);
+    int root2 = find(ind2);
+
+    if (root1 == root2) return;
+
+    parent_[root2] = root1;
+
+    --numComponents_;
+  }
+
+ private:
+  int                  rows_          { 0 };
+  int                  cols_          { 0 };
+  std::vector<uint8_t> black_;
+  std::vector<uint8_t> blockCount_;    // black cells in 2x2 block at (r, c)
+  std::vector<int>     parent_;        // union-find parent (-1 if not black)
+  int                  numBlack_      { 0 };
+  int                  numComponents_ { 0 };
+};
+
+#endif
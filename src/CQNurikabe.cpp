@@ -221,6 +221,62 @@ redraw()
   update();
 }
 
+// redraw only changed cells into cached board pixmap
+void
+CQNurikabeCanvas::
+redraw(const CNurikabe::Coords &coords)
+{
+  if (! canDrawIncremental()) {
+    redraw();
+    return;
+  }
+
+  const CNurikabe *nurikabe = app_->getNurikabe();
+
+  QPainter painter;
+
+  painter.begin(&pixmap_);
+
+  QRect drect;
+
+  CNurikabe::Coords::const_iterator pc1, pc2;
+
+  for (pc1 = coords.begin(), pc2 = coords.end(); pc1 != pc2; ++pc1) {
+    const CNurikabe::Coord &coord = *pc1;
+
+    int x, y;
+
+    cellToXY(coord.row, coord.col, &x, &y);
+
+    drawCell(&painter, nurikabe->getCell(coord), x, y);
+
+    // include right/bottom grid line
+    drect |= QRect(x, y, cell_size_ + 1, cell_size_ + 1);
+  }
+
+  painter.end();
+
+  if (! drect.isEmpty())
+    update(drect);
+}
+
+bool
+CQNurikabeCanvas::
+canDrawIncremental()
+{
+  if (pixmap_.isNull())
+    return false;
+
+  // overlays and constraints can change for cells outside the changed set
+  if (showConnection_ || showSolution_ || showSolutions_ || drawConstraint_)
+    return false;
+
+  if (! graph_.getEdges().empty())
+    return false;
+
+  return true;
+}
+
 void
 CQNurikabeCanvas::
 mousePressEvent(QMouseEvent *e)
@@ -696,93 +752,82 @@ drawBoard(QPainter *painter)
   int num_rows = nurikabe->getNumRows();
   int num_cols = nurikabe->getNumCols();
 
-  QFontMetrics fm(font_);
-
   int y = dy_;
 
   for (int i = 0; i < num_rows; ++i) {
     int x = dx_;
 
     for (int j = 0; j < num_cols; ++j) {
-       CNurikabe::Coord coord(i, j);
+      CNurikabe::Coord coord(i, j);
 
-       const CNurikabe::Cell *cell = nurikabe->getCell(coord);
+      drawCell(painter, nurikabe->getCell(coord), x, y);
 
-       if      (cell->isNumber()) {
-         painter->setFont(font_);
-
-         QString str = QString("%1").arg(cell->getNumber());
+      x += cell_size_;
+    }
 
-         int char_width = fm.horizontalAdvance(str);
+    y += cell_size_;
+  }
+}
 
-         painter->setPen(QPen(Qt::black));
+void
+CQNurikabeCanvas::
+drawCell(QPainter *painter, const CNurikabe::Cell *cell, int x, int y)
+{
+  QRect rect(x, y, cell_size_, cell_size_);
 
-         painter->drawText(x + cell_size_/2 - char_width/2,
-                           y + cell_size_/2 + char_height_/2 - char_descent_,
-                           str);
-       }
-       else if (cell->isWhite()) {
-         QRect rect(x, y, cell_size_, cell_size_);
+  if      (cell->isNumber()) {
+    painter->fillRect(rect, QBrush(QColor(255, 255, 255)));
 
-         painter->fillRect(rect, QBrush(QColor(255, 255, 255)));
+    QFontMetrics fm(font_);
 
-         if (drawConstraint_)
-           drawRegionConstraint(painter, cell, x, y);
-       }
-       else if (cell->isBlack()) {
-         QRect rect(x, y, cell_size_, cell_size_);
+    painter->setFont(font_);
 
-         painter->fillRect(rect, QBrush(QColor(0, 0, 0)));
-       }
-       else { // unknown
-         QRect rect(x, y, cell_size_, cell_size_);
+    QString str = QString("%1").arg(cell->getNumber());
 
-         painter->fillRect(rect, QBrush(QColor(200, 200, 200)));
+    int char_width = fm.horizontalAdvance(str);
 
-         if (drawConstraint_)
-           drawRegionConstraint(painter, cell, x, y);
-       }
+    painter->setPen(QPen(Qt::black));
 
-       if (cell == currentCell_) {
-         QRect rect(x, y, cell_size_, cell_size_);
+    painter->drawText(x + cell_size_/2 - char_width/2,
+                      y + cell_size_/2 + char_height_/2 - char_descent_,
+                      str);
+  }
+  else if (cell->isWhite()) {
+    painter->fillRect(rect, QBrush(QColor(255, 255, 255)));
 
-         painter->setPen(QColor(200, 100, 100));
+    if (drawConstraint_)
+      drawRegionConstraint(painter, cell, x, y);
+  }
+  else if (cell->isBlack()) {
+    painter->fillRect(rect, QBrush(QColor(0, 0, 0)));
+  }
+  else { // unknown
+    painter->fillRect(rect, QBrush(QColor(200, 200, 200)));
 
-         painter->drawRect(rect);
+    if (drawConstraint_)
+      drawRegionConstraint(painter, cell, x, y);
+  }
 
-         painter->fillRect(rect, QBrush(QColor(0, 255, 0, 80)));
-       }
+  if (cell == currentCell_) {
+    painter->setPen(QColor(200, 100, 100));
 
-       x += cell_size_;
-     }
+    painter->drawRect(rect);
 
-     y += cell_size_;
+    painter->fillRect(rect, QBrush(QColor(0, 255, 0, 80)));
   }
 
   //-----
 
-  int x1 = dx_, x2 = x1 + num_cols*cell_size_;
-  int y1 = dy_, y2 = y1 + num_rows*cell_size_;
+  // grid lines
+  int x1 = x, x2 = x + cell_size_;
+  int y1 = y, y2 = y + cell_size_;
 
   painter->setPen(QPen(QColor(128, 128, 128)));
 
-  x1 = dx_;
-  y1 = dy_;
-
-  for (int i = 0; i <= num_cols; ++i) {
-    painter->drawLine(x1, y1, x1, y2);
-
-    x1 += cell_size_;
-  }
-
-  x1 = dx_;
-  y1 = dy_;
-
-  for (int i = 0; i <= num_rows; ++i) {
-    painter->drawLine(x1, y1, x2, y1);
-
-    y1 += cell_size_;
-  }
+  painter->drawLine(x1, y1, x2, y1);
+  painter->drawLine(x1, y2, x2, y2);
+  painter->drawLine(x1, y1, x1, y2);
+  painter->drawLine(x2, y1, x2, y2);
 }
 
 void
@@ -1027,20 +1072,19 @@ CQNurikabe::
 CQNurikabe(CQNurikabeApp *app) :
  app_(app), timer_(-1)
 {
+  setObserver(this);
 }
 
 void
 CQNurikabe::
-setBusy(bool busy) const
+setBusy(bool busy)
 {
-  CQNurikabe *th = const_cast<CQNurikabe *>(this);
-
   CNurikabe *nurikabe = app_->getNurikabe();
 
   if (busy) {
     app_->showMessage(QString("Busy (%1)").arg(nurikabe->getGrid()->getCoordDepth()));
 
-    CHRTimerMgrInst->start(&th->timer_);
+    CHRTimerMgrInst->start(&timer_);
   }
   else {
     app_->showMessage(QString("Ready (%1)").arg(nurikabe->getGrid()->getCoordDepth()));
@@ -1048,7 +1092,7 @@ setBusy(bool busy) const
     if (timer_ >= 0)
       CHRTimerMgrInst->end(timer_);
 
-    th->timer_ = -1;
+    timer_ = -1;
   }
 
   //app_->getCanvas()->update();
@@ -1082,9 +1126,9 @@ checkBreak()
 
 void
 CQNurikabe::
-notifyChanged()
+notifyChanged(const CNurikabe::Coords &coords)
 {
-  app_->getCanvas()->redraw();
+  app_->getCanvas()->redraw(coords);
 
   QApplication::processEvents();
 }
@@ -17,13 +17,19 @@ class CQNurikabeCanvas : public QWidget {
 
   void redraw();
 
+  void redraw(const CNurikabe::Coords &coords);
+
   bool getEscape() const { return escape_; }
 
  private:
   void draw();
 
+  bool canDrawIncremental();
+
   void drawBoard(QPainter *painter);
 
+  void drawCell(QPainter *painter, const CNurikabe::Cell *cell, int x, int y);
+
   void drawRegionConstraint(QPainter *painter, const CNurikabe::Cell *cell, int x, int y);
 
   void drawConnections(QPainter *painter, const CNurikabe::Solutions &solutions);
@@ -85,14 +91,14 @@ class CQNurikabeCanvas : public QWidget {
 
 class CQNurikabeApp;
 
-class CQNurikabe : public CNurikabe {
+class CQNurikabe : public CNurikabe, public CNurikabe::Observer {
  public:
   CQNurikabe(CQNurikabeApp *app);
 
-  void setBusy(bool busy) const override;
+  void setBusy(bool busy) override;
   bool checkBreak() override;
 
-  void notifyChanged() override;
+  void notifyChanged(const CNurikabe::Coords &coords) override;
 
   bool isBusy() { return timer_ != -1; }
 
@@ -8,15 +8,28 @@ DEPENDPATH += .
 
 QMAKE_CXXFLAGS += -std=c++17
 
+# solver trace (CNURIKABE_LOG) is compiled out of release builds
+CONFIG(release, debug|release): DEFINES += CNURIKABE_NO_TRACE
+
 #CONFIG += debug
 
 # Input
 SOURCES += \
 CNurikabe.cpp \
+CNurikabeTrace.cpp \
 CQNurikabe.cpp
 
 HEADERS += \
 CNurikabe.h \
+CNurikabeBitBoard.h \
+CNurikabeBitKernels.h \
+CNurikabeImplications.h \
+CNurikabeLog.h \
+CNurikabeNogoods.h \
+CNurikabePatterns.h \
+CNurikabeRand.h \
+CNurikabeTrace.h \
+CNurikabeWall.h \
 CQNurikabe.h \
 Puzzles.h \
 help.xpm